@@ -0,0 +1,759 @@
+/*
+  ==============================================================================
+
+    Micro-benchmarks for the processing stages, run from the headless
+    renderer. Each one prints a small table to stdout.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <iostream>
+
+//==============================================================================
+namespace Benchmarks
+{
+    // Average wall-clock time per call, in microseconds.
+    template <typename Function>
+    double timePerCall (int numCalls, Function&& function)
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numCalls; ++i)
+            function();
+
+        auto elapsed = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        return elapsed * 1.0e6 / numCalls;
+    }
+
+    inline void fillWithNoise (juce::AudioBuffer<float>& buffer, juce::Random& random)
+    {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample (ch, i, random.nextFloat() * 0.2f - 0.1f);
+    }
+
+    inline void printRow (int blockSize, int numChannels, double sampleRate, double microsPerBlock,
+                          const juce::String& label = {})
+    {
+        auto budget = blockSize * 1.0e6 / sampleRate;
+
+        std::cout << label << (label.isEmpty() ? "" : "  ")
+                  << "block " << juce::String (blockSize).paddedLeft (' ', 5)
+                  << "  " << juce::String (microsPerBlock, 2).paddedLeft (' ', 9) << " us/block"
+                  << "  " << juce::String (microsPerBlock * 1000.0 / (blockSize * numChannels), 2).paddedLeft (' ', 8) << " ns/sample/channel"
+                  << "  " << juce::String (100.0 * microsPerBlock / budget, 2).paddedLeft (' ', 7) << "% of realtime"
+                  << std::endl;
+    }
+
+    //==============================================================================
+    // Exponentially decaying stereo noise, standing in for a real hall response.
+    inline juce::AudioBuffer<float> createSyntheticImpulseResponse (double sampleRate, double seconds)
+    {
+        juce::Random random (1234);
+        juce::AudioBuffer<float> ir (2, (int) (sampleRate * seconds));
+
+        for (int ch = 0; ch < ir.getNumChannels(); ++ch)
+            for (int i = 0; i < ir.getNumSamples(); ++i)
+                ir.setSample (ch, i, (random.nextFloat() * 2.0f - 1.0f)
+                                       * (float) std::exp (-6.9 * i / ir.getNumSamples()));
+
+        return ir;
+    }
+
+    // The tail thread is switched off, so that all the work is timed in the
+    // one thread, and then split into what stays on the audio thread (the
+    // head and the mixing) and what the tail thread takes off it.
+    inline void runReverb (const juce::File& impulseResponseFile)
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int numChannels = 2;
+        juce::Random random (42);
+
+        std::cout << "Master convolution reverb, "
+                  << (impulseResponseFile.existsAsFile() ? impulseResponseFile.getFileName() : juce::String ("4 s synthetic IR"))
+                  << ", " << numChannels << " channels at " << sampleRate << " Hz" << std::endl;
+
+        for (auto blockSize : { 32, 64, 128, 256, 512, 1024 })
+        {
+            MasterReverb reverb;
+            reverb.setEnabled (true);
+            reverb.setTailThreadEnabled (false);
+            reverb.prepare (sampleRate, blockSize, numChannels);
+
+            if (impulseResponseFile.existsAsFile())
+                reverb.loadImpulseResponse (impulseResponseFile);
+            else
+                reverb.loadImpulseResponse (createSyntheticImpulseResponse (sampleRate, 4.0), sampleRate);
+
+            juce::AudioBuffer<float> buffer (numChannels, blockSize);
+
+            // The impulse response is installed from the background loader on a
+            // later process() call, so keep feeding blocks until it's there.
+            for (int i = 0; i < 1000 && ! reverb.hasImpulseResponse(); ++i)
+            {
+                fillWithNoise (buffer, random);
+                reverb.process (buffer, 0, blockSize);
+                juce::Thread::sleep (5);
+            }
+
+            fillWithNoise (buffer, random);
+            auto numBlocks = juce::jmax (200, (int) (sampleRate * 10.0) / blockSize);
+
+            auto tailBefore = reverb.getStats().tailMicros;
+            auto totalMicros = timePerCall (numBlocks, [&] { reverb.process (buffer, 0, blockSize); });
+            auto tailMicros = (reverb.getStats().tailMicros - tailBefore) / numBlocks;
+
+            printRow (blockSize, numChannels, sampleRate, totalMicros - tailMicros, "audio thread");
+            printRow (blockSize, numChannels, sampleRate, tailMicros,               "tail thread ");
+        }
+    }
+
+    //==============================================================================
+    // Four held notes through SynthAudioSource at each oversampling factor.
+    inline void runOversampling()
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int numChannels = 2, blockSize = 256;
+
+        std::cout << "Voice rendering with oversampling, " << SynthAudioSource::numVoices << " held notes, "
+                  << numChannels << " channels at " << sampleRate << " Hz" << std::endl;
+
+        for (int order = 0; order <= SynthAudioSource::maxOversamplingOrder; ++order)
+        {
+            SynthAudioSource source;
+            source.setOversamplingOrder (order);
+            source.prepareToPlay (blockSize, sampleRate);
+
+            juce::AudioBuffer<float> buffer (numChannels, blockSize);
+            juce::MidiBuffer midi;
+
+            for (auto note : { 48, 55, 60, 64 })
+                midi.addEvent (juce::MidiMessage::noteOn (1, note, 0.8f), 0);
+
+            source.renderNextBlock (juce::AudioSourceChannelInfo (buffer), midi);
+            midi.clear();
+
+            auto numBlocks = (int) (sampleRate * 10.0) / blockSize;
+
+            printRow (blockSize, numChannels, sampleRate,
+                      timePerCall (numBlocks, [&] { source.renderNextBlock (juce::AudioSourceChannelInfo (buffer), midi); }),
+                      juce::String (1 << order) + "x (" + juce::String (source.getLatencySamples()) + " samples latency)");
+        }
+    }
+
+    //==============================================================================
+    // The FM voices through a plain juce::Synthesiser, with every voice held.
+    inline void runFm (int numVoices)
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int numChannels = 2;
+
+        std::cout << "FM voices, " << numVoices << " held notes, " << numChannels << " channels at "
+                  << sampleRate << " Hz, kernels " << RenderKernels::getActive().name << std::endl;
+
+        for (auto blockSize : { 64, 256, 1024 })
+        {
+            FmVoiceBank bank (numVoices);
+            bank.prepare (blockSize);
+
+            juce::Synthesiser synth;
+            synth.addSound (new FmSound());
+
+            for (int i = 0; i < numVoices; ++i)
+                synth.addVoice (new FmVoice (bank, i));
+
+            synth.setCurrentPlaybackSampleRate (sampleRate);
+
+            for (int i = 0; i < numVoices; ++i)
+                synth.noteOn (1, 24 + i, 0.8f);
+
+            juce::AudioBuffer<float> buffer (numChannels, blockSize);
+            juce::MidiBuffer midi;
+
+            auto renderBlock = [&]
+            {
+                buffer.clear();
+                bank.beginBlock (0, blockSize);
+                synth.renderNextBlock (buffer, midi, 0, blockSize);
+            };
+
+            renderBlock();
+            auto numBlocks = (int) (sampleRate * 10.0) / blockSize;
+
+            printRow (blockSize, numChannels, sampleRate, timePerCall (numBlocks, renderBlock));
+        }
+    }
+
+    //==============================================================================
+    // Low notes of the additive sawtooth, so that every voice keeps all its partials.
+    inline void runAdditive (int numVoices)
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int numChannels = 2;
+
+        std::cout << "Additive voices, " << numVoices << " held notes of " << AdditiveVoice::maxPartials
+                  << " partials, " << numChannels << " channels at " << sampleRate << " Hz, kernels "
+                  << RenderKernels::getActive().name << std::endl;
+
+        for (auto blockSize : { 64, 256, 1024 })
+        {
+            juce::Synthesiser synth;
+            synth.addSound (new AdditiveSound (AdditiveSound::createSawtooth (AdditiveVoice::maxPartials)));
+
+            for (int i = 0; i < numVoices; ++i)
+                synth.addVoice (new AdditiveVoice());
+
+            synth.setCurrentPlaybackSampleRate (sampleRate);
+
+            for (int i = 0; i < numVoices; ++i)
+                synth.noteOn (1, 24 + i, 0.8f);
+
+            juce::AudioBuffer<float> buffer (numChannels, blockSize);
+            juce::MidiBuffer midi;
+
+            auto renderBlock = [&]
+            {
+                buffer.clear();
+                synth.renderNextBlock (buffer, midi, 0, blockSize);
+            };
+
+            renderBlock();
+            auto numBlocks = (int) (sampleRate * 10.0) / blockSize;
+
+            printRow (blockSize, numChannels, sampleRate, timePerCall (numBlocks, renderBlock));
+        }
+    }
+
+    //==============================================================================
+    // Runs kernel (dest, numSamples) over totalSamples in chunks of
+    // maxChunkSize, returning what it wrote and setting the time per sample.
+    template <typename Kernel>
+    std::vector<float> runKernel (int totalSamples, double& nanosPerSample, Kernel&& kernel)
+    {
+        std::vector<float> output ((size_t) totalSamples);
+
+        auto micros = timePerCall (1, [&]
+        {
+            for (int start = 0; start < totalSamples; start += RenderKernels::maxChunkSize)
+                kernel (output.data() + start, juce::jmin ((int) RenderKernels::maxChunkSize, totalSamples - start));
+        });
+
+        nanosPerSample = micros * 1000.0 / totalSamples;
+        return output;
+    }
+
+    // The SNR of test against reference over samples [begin, end), in dB.
+    inline double computeSnrDb (const std::vector<float>& reference, const std::vector<float>& test,
+                                size_t begin, size_t end)
+    {
+        double signal = 0.0, noise = 0.0;
+
+        for (auto i = begin; i < end; ++i)
+        {
+            auto diff = (double) test[i] - (double) reference[i];
+            signal += (double) reference[i] * (double) reference[i];
+            noise  += diff * diff;
+        }
+
+        return noise > 0.0 ? 10.0 * std::log10 (signal / noise) : std::numeric_limits<double>::infinity();
+    }
+
+    inline juce::String formatSnr (double snrDb)
+    {
+        return std::isinf (snrDb) ? juce::String ("exact") : juce::String (snrDb, 1) + " dB";
+    }
+
+    inline void printKernelRow (const juce::String& label, const RenderKernels& kernels, double nanosPerSample,
+                                double referenceNanos, const juce::String& error)
+    {
+        std::cout << "  " << label.paddedRight (' ', 16)
+                  << juce::String (kernels.name).paddedRight (' ', 10)
+                  << juce::String (nanosPerSample, 2).paddedLeft (' ', 9) << " ns/sample"
+                  << juce::String (referenceNanos / nanosPerSample, 2).paddedLeft (' ', 8) << "x reference"
+                  << "  SNR " << error << std::endl;
+    }
+
+    // A 440 Hz sine at the level SineWaveVoice gives a full-velocity note.
+    inline std::vector<float> runOscillatorKernel (const RenderKernels& kernels, double sampleRate,
+                                                   int totalSamples, double& nanosPerSample)
+    {
+        VoiceRenderState s;
+        s.angleDelta = juce::MathConstants<double>::twoPi * 440.0 / sampleRate;
+        s.level = 0.15;
+
+        return runKernel (totalSamples, nanosPerSample, [&] (float* dest, int n) { kernels.oscillator (dest, n, s); });
+    }
+
+    // The same sine released with a long decay, so that the tail-off lasts
+    // for most of the run.
+    inline std::vector<float> runTailOffKernel (const RenderKernels& kernels, double sampleRate,
+                                                int totalSamples, double& nanosPerSample)
+    {
+        VoiceRenderState s;
+        s.angleDelta = juce::MathConstants<double>::twoPi * 440.0 / sampleRate;
+        s.level = 0.15;
+        s.tailOff = 1.0;
+        s.decay = 0.99999;
+        auto finished = false;
+
+        return runKernel (totalSamples, nanosPerSample, [&] (float* dest, int n)
+        {
+            if (! finished)
+                finished = kernels.tailOff (dest, n, s) < n;
+        });
+    }
+
+    // The additive sawtooth's partials on its lowest note, as AdditiveVoice
+    // sets them up at note-on.
+    inline std::vector<PartialGroup> createSawtoothPartials (double angleDelta)
+    {
+        std::vector<PartialGroup> groups ((size_t) AdditiveVoice::maxPartials / PartialGroup::numLanes);
+
+        for (int k = 0; k < AdditiveVoice::maxPartials; ++k)
+        {
+            auto& g = groups[(size_t) k / PartialGroup::numLanes];
+            auto l = k % PartialGroup::numLanes;
+            auto angle = angleDelta * (k + 1);
+
+            g.re[l] = 1.0f;
+            g.im[l] = 0.0f;
+            g.cosine[l] = (float) std::cos (angle);
+            g.sine[l] = (float) std::sin (angle);
+            g.amplitude[l] = 1.0f / (float) (k + 1);
+        }
+
+        return groups;
+    }
+
+    inline std::vector<float> runPartialsKernel (const RenderKernels& kernels, double angleDelta,
+                                                 int totalSamples, double& nanosPerSample)
+    {
+        auto groups = createSawtoothPartials (angleDelta);
+
+        return runKernel (totalSamples, nanosPerSample, [&] (float* dest, int n)
+        {
+            kernels.partials (dest, n, groups.data(), (int) groups.size());
+        });
+    }
+
+    // What the partials kernel approximates: the same sines, summed in double.
+    inline std::vector<float> computeExactSawtooth (double angleDelta, int totalSamples)
+    {
+        std::vector<float> output ((size_t) totalSamples);
+
+        for (int i = 0; i < totalSamples; ++i)
+        {
+            auto sum = 0.0;
+
+            for (int k = 1; k <= AdditiveVoice::maxPartials; ++k)
+                sum += std::sin (angleDelta * k * i) / k;
+
+            output[(size_t) i] = (float) sum;
+        }
+
+        return output;
+    }
+
+    //==============================================================================
+    // Every kernel level this CPU supports against the reference kernels: the
+    // time per sample of the oscillator, tail-off and partials kernels and the
+    // SNR of their output against the reference's, then the same for whole
+    // renders of the golden scenarios. The partials are also compared with
+    // exact sines over the whole run and over its last second, which shows how
+    // far the rotating phasors have drifted by then.
+    inline void runKernels()
+    {
+        constexpr double sampleRate = 48000.0, seconds = 10.0;
+        constexpr int totalSamples = (int) (sampleRate * seconds);
+        auto levels = RenderKernels::getSupportedLevels();
+        auto previousLevel = RenderKernels::getActive().level;
+
+        std::cout << "Render kernels against the reference set, " << seconds << " s at " << sampleRate << " Hz" << std::endl;
+
+        double referenceNanos = 0.0;
+        std::vector<float> expected;
+
+        // Runs one kernel at every level; the reference level comes first and
+        // is what the others are compared with.
+        auto compareLevels = [&] (const juce::String& label, int samplesPerOutput, auto&& runLevel, auto&& describeError)
+        {
+            for (auto level : levels)
+            {
+                auto& kernels = *RenderKernels::forLevel (level);
+                double nanos = 0.0;
+                auto output = runLevel (kernels, nanos);
+                nanos /= samplesPerOutput;
+
+                if (level == RenderKernels::Level::reference)
+                {
+                    expected = output;
+                    referenceNanos = nanos;
+                }
+
+                printKernelRow (label, kernels, nanos, referenceNanos,
+                                formatSnr (computeSnrDb (expected, output, 0, expected.size())) + describeError (output));
+            }
+        };
+
+        auto noMoreError = [] (const std::vector<float>&) { return juce::String(); };
+
+        compareLevels ("oscillator", 1, [&] (const RenderKernels& k, double& nanos)
+                                        { return runOscillatorKernel (k, sampleRate, totalSamples, nanos); },
+                       noMoreError);
+
+        compareLevels ("tail-off", 1, [&] (const RenderKernels& k, double& nanos)
+                                      { return runTailOffKernel (k, sampleRate, totalSamples, nanos); },
+                       noMoreError);
+
+        // Timed per partial, so the figure is what one partial of one voice costs per sample.
+        auto angleDelta = juce::MathConstants<double>::twoPi * juce::MidiMessage::getMidiNoteInHertz (24) / sampleRate;
+        auto exact = computeExactSawtooth (angleDelta, totalSamples);
+        auto lastSecond = exact.size() - (size_t) sampleRate;
+
+        compareLevels ("partial", AdditiveVoice::maxPartials,
+                       [&] (const RenderKernels& k, double& nanos) { return runPartialsKernel (k, angleDelta, totalSamples, nanos); },
+                       [&] (const std::vector<float>& output)
+                       {
+                           return ", against exact sines " + formatSnr (computeSnrDb (exact, output, 0, exact.size()))
+                                    + " overall and " + formatSnr (computeSnrDb (exact, output, lastSecond, exact.size()))
+                                    + " in the last second";
+                       });
+
+        std::cout << "Golden scenarios" << std::endl;
+        RenderSettings settings;
+
+        for (auto& scenario : OfflineRenderer::createScenarios())
+        {
+            juce::AudioBuffer<float> referenceRender;
+
+            for (auto level : levels)
+            {
+                RenderKernels::setActiveLevel (level);
+                juce::AudioBuffer<float> output;
+                auto micros = timePerCall (1, [&] { output = OfflineRenderer::render (scenario, settings); });
+                auto nanosPerSample = micros * 1000.0 / output.getNumSamples();
+
+                if (level == RenderKernels::Level::reference)
+                {
+                    referenceRender = output;
+                    referenceNanos = nanosPerSample;
+                }
+
+                printKernelRow (scenario.name, RenderKernels::getActive(), nanosPerSample, referenceNanos,
+                                formatSnr (OfflineRenderer::computeSnrDb (referenceRender, output)));
+            }
+        }
+
+        RenderKernels::setActiveLevel (previousLevel);
+    }
+
+    //==============================================================================
+    // What the trace scopes cost: the time one scope takes to record, and how
+    // many the golden scenarios record, as a share of their render time. The
+    // per-scope time comes from a tight loop, so it's a lower bound.
+    inline void runTraceOverhead()
+    {
+       #if SYNTH_TRACE
+        constexpr int numScopes = 1000000;
+
+        auto nanosPerScope = timePerCall (numScopes, [] { SYNTH_TRACE_SCOPE ("benchmark"); }) * 1000.0;
+
+        RenderSettings settings;
+        auto before = Trace::getNumRecorded();
+        auto renderMicros = 0.0;
+
+        for (auto& scenario : OfflineRenderer::createScenarios())
+            renderMicros += timePerCall (1, [&] { OfflineRenderer::render (scenario, settings); });
+
+        auto numRecorded = (double) (Trace::getNumRecorded() - before);
+        auto overheadMicros = numRecorded * nanosPerScope * 0.001;
+
+        std::cout << "Trace scopes" << std::endl
+                  << "  one scope         " << juce::String (nanosPerScope, 1) << " ns" << std::endl
+                  << "  golden scenarios  " << juce::String (numRecorded, 0) << " scopes in "
+                  << juce::String (renderMicros * 0.001, 2) << " ms of rendering" << std::endl
+                  << "  overhead          " << juce::String (100.0 * overheadMicros / juce::jmax (1.0e-9, renderMicros - overheadMicros), 3)
+                  << "% of the untraced render time" << std::endl;
+       #else
+        std::cout << "This build has no trace scopes; configure with -DSYNTH_ENABLE_TRACE=ON" << std::endl;
+       #endif
+    }
+
+    //==============================================================================
+    // Alternates between two presets every block with four notes held, going
+    // through the binary form each time as a preset file would.
+    inline void runPresetRecall()
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int numChannels = 2, blockSize = 256, numRecalls = 2000;
+
+        SynthAudioSource source;
+        source.prepareToPlay (blockSize, sampleRate);
+
+        EnginePreset presets[2];
+        presets[1].decay = 0.9995;
+        presets[1].filterEnabled = true;
+        presets[1].cutoffHz = 800.0f;
+        presets[1].fmAlgorithm = 4;
+
+        for (auto& part : presets[1].parts)
+            part.sound = EnginePreset::organSound;
+
+        juce::MemoryBlock data[] = { presets[0].toBinary(), presets[1].toBinary() };
+
+        juce::AudioBuffer<float> buffer (numChannels, blockSize);
+        juce::MidiBuffer midi;
+
+        for (auto note : { 48, 55, 60, 64 })
+            midi.addEvent (juce::MidiMessage::noteOn (1, note, 0.8f), 0);
+
+        source.renderNextBlock (juce::AudioSourceChannelInfo (buffer), midi);
+        midi.clear();
+
+        double prepareMicros = 0.0, applyMicros = 0.0, maxApplyMicros = 0.0, maxLatencyMs = 0.0;
+
+        for (int i = 0; i < numRecalls; ++i)
+        {
+            auto& binary = data[i % 2];
+
+            prepareMicros += timePerCall (1, [&]
+            {
+                EnginePreset preset;
+                EnginePreset::fromBinary (binary.getData(), binary.getSize(), preset);
+                source.recallPreset (preset);
+            });
+
+            source.renderNextBlock (juce::AudioSourceChannelInfo (buffer), midi);
+
+            auto stats = source.getRecallStats();
+            applyMicros += stats.lastApplyMicros;
+            maxApplyMicros = juce::jmax (maxApplyMicros, stats.lastApplyMicros);
+            maxLatencyMs = juce::jmax (maxLatencyMs, stats.lastLatencyMs);
+        }
+
+        std::cout << "Preset recall, " << (int) data[0].getSize() << " byte presets, block " << blockSize
+                  << " at " << sampleRate << " Hz" << std::endl
+                  << "  parse and prepare  " << juce::String (prepareMicros / numRecalls, 2) << " us (message thread)" << std::endl
+                  << "  apply              " << juce::String (applyMicros / numRecalls, 3) << " us mean, "
+                  << juce::String (maxApplyMicros, 3) << " us max (audio thread)" << std::endl
+                  << "  recall to apply    " << juce::String (maxLatencyMs, 3) << " ms max here; live, at most one block ("
+                  << juce::String (blockSize * 1000.0 / sampleRate, 2) << " ms) plus the device's buffering" << std::endl;
+    }
+
+    //==============================================================================
+    // The fixed cost of an audio callback with nothing playing, which is what
+    // sets the floor at tiny buffer sizes, with low-latency mode off and on.
+    inline void runCallbackOverhead()
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int numChannels = 2, numCallbacks = 100000;
+
+        std::cout << "Audio callback overhead with no notes, " << numChannels << " channels at " << sampleRate << " Hz" << std::endl;
+
+        for (auto lowLatency : { false, true })
+        {
+            for (auto blockSize : { 16, 32, 64, 128, 256 })
+            {
+                SynthAudioSource source;
+                source.prepareToPlay (blockSize, sampleRate);
+                source.setLowLatencyMode (lowLatency);
+
+                juce::AudioBuffer<float> buffer (numChannels, blockSize);
+                juce::AudioSourceChannelInfo info (buffer);
+
+                for (int i = 0; i < 1000; ++i)
+                    source.getNextAudioBlock (info);
+
+                auto nanos = timePerCall (numCallbacks, [&] { source.getNextAudioBlock (info); }) * 1000.0;
+
+                std::cout << (lowLatency ? "low latency" : "normal     ")
+                          << "  block " << juce::String (blockSize).paddedLeft (' ', 4)
+                          << "  " << juce::String (nanos, 1).paddedLeft (' ', 9) << " ns/callback"
+                          << "  " << juce::String (nanos / blockSize, 2).paddedLeft (' ', 7) << " ns/sample"
+                          << std::endl;
+            }
+        }
+    }
+
+    //==============================================================================
+    // Times the blocks after prepareToPlay, with a chord on four parts, each
+    // playing a different sound, starting in the first block. Each run should
+    // be in a fresh process, so that nothing is warm beforehand except what
+    // the warm-up itself did.
+    inline void runStartup (bool warmUp)
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int numChannels = 2, blockSize = 256, numBlocks = 256;
+
+        SynthAudioSource source;
+        source.setWarmUpOnPrepare (warmUp);
+
+        auto prepareMicros = timePerCall (1, [&] { source.prepareToPlay (blockSize, sampleRate); });
+
+        const int sounds[] = { EnginePreset::sineSound, EnginePreset::fmSound, EnginePreset::organSound, EnginePreset::sawtoothSound };
+
+        for (int part = 0; part < 4; ++part)
+            source.getParts().setSound (part, sounds[part]);
+
+        juce::AudioBuffer<float> buffer (numChannels, blockSize);
+        juce::MidiBuffer midi;
+        std::vector<double> micros;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            midi.clear();
+
+            if (block == 0)
+                for (int part = 0; part < 4; ++part)
+                    for (auto note : { 48, 55, 60, 64 })
+                        midi.addEvent (juce::MidiMessage::noteOn (part + 1, note, 0.8f), 0);
+
+            micros.push_back (timePerCall (1, [&] { source.renderNextBlock (juce::AudioSourceChannelInfo (buffer), midi); }));
+        }
+
+        auto first = micros.front();
+        std::sort (micros.begin(), micros.end());
+        auto median = micros[micros.size() / 2];
+
+        std::cout << "Startup, " << (warmUp ? "with" : "without") << " warm-up, block " << blockSize
+                  << " at " << sampleRate << " Hz" << std::endl
+                  << "  prepareToPlay  " << juce::String (prepareMicros / 1000.0, 2) << " ms" << std::endl
+                  << "  first block    " << juce::String (first, 2) << " us" << std::endl
+                  << "  median block   " << juce::String (median, 2) << " us" << std::endl
+                  << "  first/median   " << juce::String (first / juce::jmax (median, 1.0e-3), 2) << "x" << std::endl;
+    }
+
+    //==============================================================================
+    // Stands in for an audio device: asks the source for a block every
+    // blockSize samples' worth of wall-clock time and throws the audio away.
+    class DummyAudioDevice   : public juce::Thread
+    {
+    public:
+        DummyAudioDevice (juce::AudioSource& sourceToUse, int numChannels, int samplesPerBlock, double rate)
+            : juce::Thread ("Dummy audio device"), source (sourceToUse),
+              buffer (numChannels, samplesPerBlock), sampleRate (rate)
+        {
+        }
+
+        ~DummyAudioDevice() override
+        {
+            stopThread (2000);
+        }
+
+        void run() override
+        {
+            auto periodMs = buffer.getNumSamples() * 1000.0 / sampleRate;
+            auto next = juce::Time::getMillisecondCounterHiRes();
+
+            while (! threadShouldExit())
+            {
+                source.getNextAudioBlock (juce::AudioSourceChannelInfo (buffer));
+                next += periodMs;
+
+                // Sleep for most of the wait and spin for the rest, as sleeps
+                // are only good to a millisecond or so.
+                while (juce::Time::getMillisecondCounterHiRes() < next - 1.5)
+                    juce::Thread::sleep (1);
+
+                while (juce::Time::getMillisecondCounterHiRes() < next)
+                    juce::Thread::yield();
+            }
+        }
+
+    private:
+        juce::AudioSource& source;
+        juce::AudioBuffer<float> buffer;
+        const double sampleRate;
+    };
+
+    // Plays notes one at a time, each into silence, through a virtual MIDI
+    // port that the engine listens to like any other input, and reports the
+    // latency from the input callback to the first sound leaving
+    // getNextAudioBlock.
+    inline bool runLatencyLoopback (int numNotes, int blockSize, const RealtimeSetup::Options& realtimeOptions)
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int numChannels = 2;
+        const juce::String portName ("Synth latency loopback");
+
+        auto output = juce::MidiOutput::createNewDevice (portName);
+
+        if (output == nullptr)
+        {
+            std::cerr << "Couldn't create a virtual MIDI port; this needs ALSA or CoreMIDI" << std::endl;
+            return false;
+        }
+
+        // The port can take a moment to show up as an input.
+        juce::MidiDeviceInfo loopback;
+
+        for (int attempt = 0; attempt < 50 && loopback.identifier.isEmpty(); ++attempt)
+        {
+            for (auto& input : juce::MidiInput::getAvailableDevices())
+                if (input.name.contains (portName))
+                    loopback = input;
+
+            if (loopback.identifier.isEmpty())
+                juce::Thread::sleep (20);
+        }
+
+        if (loopback.identifier.isEmpty())
+        {
+            std::cerr << "The virtual MIDI port didn't appear as an input" << std::endl;
+            return false;
+        }
+
+        SynthAudioSource source;
+        source.getRealtimeSetup().setOptions (realtimeOptions);
+        source.prepareToPlay (blockSize, sampleRate);
+        source.setLatencyProbeEnabled (true);
+
+        auto input = juce::MidiInput::openDevice (loopback.identifier, source.getMidiInputs().openPort (loopback.identifier));
+
+        if (input == nullptr)
+        {
+            std::cerr << "Couldn't open " << loopback.name << std::endl;
+            return false;
+        }
+
+        input->start();
+
+        DummyAudioDevice device (source, numChannels, blockSize, sampleRate);
+        device.startThread (9);
+
+        juce::Random random (7);
+
+        for (int i = 0; i < numNotes; ++i)
+        {
+            // A random offset so that notes land all over the block.
+            juce::Thread::sleep (random.nextInt (10));
+
+            auto note = 48 + i % 24;
+            output->sendMessageNow (juce::MidiMessage::noteOn (1, note, 0.8f));
+            juce::Thread::sleep (50);
+            output->sendMessageNow (juce::MidiMessage::noteOff (1, note));
+            juce::Thread::sleep (250);
+        }
+
+        device.stopThread (2000);
+        input->stop();
+
+        for (auto& line : source.getRealtimeSetup().getReport())
+            std::cout << line << std::endl;
+
+        auto p = source.getLatencyProbe().getPercentiles();
+
+        std::cout << "MIDI-to-audio latency, " << p.numMeasured << " of " << numNotes << " notes, block " << blockSize
+                  << " at " << sampleRate << " Hz" << std::endl
+                  << "  p50 " << juce::String (p.p50Ms, 3) << " ms, p99 " << juce::String (p.p99Ms, 3)
+                  << " ms, max " << juce::String (p.maxMs, 3) << " ms"
+                  << (p.numUnmatched > 0 ? ", " + juce::String ((juce::int64) p.numUnmatched) + " unmatched" : juce::String())
+                  << std::endl
+                  << "  a real device adds its output buffering, at least one block ("
+                  << juce::String (blockSize * 1000.0 / sampleRate, 2) << " ms)" << std::endl;
+
+        return p.numMeasured > 0;
+    }
+}
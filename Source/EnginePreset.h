@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    Everything the GUI can set on the engine, as one value with a compact
+    binary form: a four byte tag and a version, then the fields in a fixed
+    little-endian layout. The MIDI inputs are stored by device identifier,
+    one per line, and are applied by whoever owns the device manager, not by
+    the engine.
+
+    Version 1 had a single sound for every channel; loading one gives all
+    parts that sound. Versions 1 and 2 had no velocity curve or key
+    tracking; loading one gives the linear curve and flat keys. Version 3
+    had no power curve, so its exponent loads as 1.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+struct EnginePreset
+{
+    // Sound slots, in the order the GUI lists them.
+    enum Sound
+    {
+        sineSound,
+        fmSound,
+        organSound,
+        sawtoothSound,
+        samplerSound,
+        numSounds
+    };
+
+    double decay = 0.999;
+
+    bool filterEnabled = false;
+    float cutoffHz = 2000.0f, resonance = 0.707f, filterEnvelopeOctaves = 2.0f;
+
+    bool reverbEnabled = false;
+    float reverbWet = 0.3f;
+
+    int oversamplingOrder = 0;
+    int fmAlgorithm = 0;
+
+    PartBank::Settings parts[PartBank::numParts];
+    NoteResponse::Settings noteResponse;
+
+    juce::StringArray midiInputIdentifiers;
+
+    static constexpr const char* fileExtension = ".synthpreset";
+
+    //==============================================================================
+    juce::MemoryBlock toBinary() const
+    {
+        juce::MemoryOutputStream out (64);
+
+        out.writeInt (tag);
+        out.writeShort ((short) currentVersion);
+        out.writeDouble (decay);
+        out.writeBool (filterEnabled);
+        out.writeFloat (cutoffHz);
+        out.writeFloat (resonance);
+        out.writeFloat (filterEnvelopeOctaves);
+        out.writeBool (reverbEnabled);
+        out.writeFloat (reverbWet);
+        out.writeByte ((char) oversamplingOrder);
+        out.writeByte ((char) fmAlgorithm);
+
+        for (auto& part : parts)
+        {
+            out.writeByte ((char) part.sound);
+            out.writeFloat (part.level);
+            out.writeFloat (part.pan);
+            out.writeByte ((char) part.polyphony);
+        }
+
+        out.writeByte ((char) noteResponse.velocityCurve);
+        out.writeFloat (noteResponse.keyTrackingDbPerOctave);
+        out.writeByte ((char) noteResponse.keyCentre);
+        out.writeFloat (noteResponse.velocityExponent);
+        out.writeString (midiInputIdentifiers.joinIntoString ("\n"));
+
+        return out.getMemoryBlock();
+    }
+
+    // Fails on anything that isn't a preset of a version this build knows.
+    // Fields that are out of range are clamped rather than rejected.
+    static bool fromBinary (const void* data, size_t size, EnginePreset& result)
+    {
+        juce::MemoryInputStream in (data, size, false);
+
+        if (size < headerSize || in.readInt() != tag)
+            return false;
+
+        auto version = (int) in.readShort();
+
+        if (version < 1 || version > currentVersion)
+            return false;
+
+        EnginePreset preset;
+        preset.decay                 = juce::jlimit (minDecay, maxDecay, in.readDouble());
+        preset.filterEnabled         = in.readBool();
+        preset.cutoffHz              = juce::jlimit (20.0f, 20000.0f, in.readFloat());
+        preset.resonance             = juce::jlimit (0.5f, 10.0f, in.readFloat());
+        preset.filterEnvelopeOctaves = juce::jlimit (0.0f, 6.0f, in.readFloat());
+        preset.reverbEnabled         = in.readBool();
+        preset.reverbWet             = juce::jlimit (0.0f, 1.0f, in.readFloat());
+        preset.oversamplingOrder     = juce::jlimit (0, maxOversamplingOrder, (int) in.readByte());
+
+        if (version == 1)
+        {
+            auto sound = readSound (in);
+
+            for (auto& part : preset.parts)
+                part.sound = sound;
+        }
+
+        preset.fmAlgorithm = juce::jlimit (0, FmVoiceBank::numAlgorithms - 1, (int) in.readByte());
+
+        if (version >= 2)
+        {
+            for (auto& part : preset.parts)
+            {
+                part.sound     = readSound (in);
+                part.level     = juce::jlimit (0.0f, 2.0f, in.readFloat());
+                part.pan       = juce::jlimit (-1.0f, 1.0f, in.readFloat());
+                part.polyphony = juce::jlimit (1, PartBank::defaultPolyphony, (int) (juce::uint8) in.readByte());
+            }
+        }
+
+        if (version >= 3)
+        {
+            auto& response = preset.noteResponse;
+            response.velocityCurve          = juce::jlimit (0, NoteCurves::numVelocityCurves - 1, (int) in.readByte());
+            response.keyTrackingDbPerOctave = juce::jlimit (-maxKeyTrackingDb, maxKeyTrackingDb, in.readFloat());
+            response.keyCentre              = juce::jlimit (0, 127, (int) in.readByte());
+        }
+
+        if (version >= 4)
+            preset.noteResponse.velocityExponent = juce::jlimit (NoteCurves::minVelocityExponent, NoteCurves::maxVelocityExponent,
+                                                                 in.readFloat());
+
+        if (in.isExhausted())
+            return false;
+
+        preset.midiInputIdentifiers = juce::StringArray::fromLines (in.readString());
+        preset.midiInputIdentifiers.removeEmptyStrings();
+        result = preset;
+        return true;
+    }
+
+    bool saveToFile (const juce::File& file) const
+    {
+        auto data = toBinary();
+        return file.replaceWithData (data.getData(), data.getSize());
+    }
+
+    static bool loadFromFile (const juce::File& file, EnginePreset& result)
+    {
+        juce::MemoryBlock data;
+        return file.loadFileAsData (data) && fromBinary (data.getData(), data.getSize(), result);
+    }
+
+    // The decay slider's range. A factor of 1 would hold a released note forever.
+    static constexpr double minDecay = 0.999, maxDecay = 0.99999;
+    static constexpr int maxOversamplingOrder = 3;
+    static constexpr float maxKeyTrackingDb = 6.0f;   // per octave, either way
+
+private:
+    static constexpr int tag = 0x504e5953;   // "SYNP"
+    static constexpr int currentVersion = 4;
+    static constexpr size_t headerSize = 6;
+
+    static int readSound (juce::InputStream& in)    { return juce::jlimit (0, numSounds - 1, (int) in.readByte()); }
+};
@@ -0,0 +1,307 @@
+/*
+  ==============================================================================
+
+    The operator state of every FM voice, kept eight voices to a lane group so
+    that the dispatched FM kernel runs them all with one vector per operator.
+
+    juce::Synthesiser renders its voices one at a time for each stretch between
+    MIDI events. The first FM voice to be asked for a stretch renders every
+    lane up to its end, and the rest just copy their lane out, so note-ons and
+    note-offs stay sample-accurate.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+struct FmPatch
+{
+    struct Operator
+    {
+        float ratio, level, decaySeconds, sustain, releaseSeconds;
+    };
+
+    Operator operators[FmLaneGroup::numOperators];
+    float feedback;   // in cycles of phase deviation
+};
+
+//==============================================================================
+class FmVoiceBank
+{
+public:
+    static constexpr int numAlgorithms = 8;
+
+    explicit FmVoiceBank (int maxVoices)
+        : numLanes (maxVoices),
+          groups ((size_t) (maxVoices + FmLaneGroup::numLanes - 1) / FmLaneGroup::numLanes),
+          states ((size_t) maxVoices, LaneState::idle),
+          levels ((size_t) maxVoices)
+    {
+        RenderKernelsDetail::getSineTable();
+    }
+
+    // The eight algorithms of the classic four-operator synths, with operator 1
+    // as index 0 and the feedback on operator 4.
+    static const FmAlgorithm& getAlgorithm (int index)
+    {
+        static const FmAlgorithm algorithms[numAlgorithms] =
+        {
+            { { 0b0010, 0b0100, 0b1000, 0 }, 0b0001 },   // 4 > 3 > 2 > 1
+            { { 0b0010, 0b1100, 0,      0 }, 0b0001 },   // (3 + 4) > 2 > 1
+            { { 0b1010, 0b0100, 0,      0 }, 0b0001 },   // (4 + (3 > 2)) > 1
+            { { 0b0110, 0,      0b1000, 0 }, 0b0001 },   // ((4 > 3) + 2) > 1
+            { { 0b0010, 0,      0b1000, 0 }, 0b0101 },   // 2 > 1, 4 > 3
+            { { 0b1000, 0b1000, 0b1000, 0 }, 0b0111 },   // 4 > (1, 2, 3)
+            { { 0,      0,      0b1000, 0 }, 0b0111 },   // 4 > 3, 2, 1
+            { { 0,      0,      0,      0 }, 0b1111 }    // 1, 2, 3, 4
+        };
+
+        return algorithms[juce::jlimit (0, numAlgorithms - 1, index)];
+    }
+
+    // Held and releasing notes are rescaled for the new carriers when the
+    // audio thread next starts or renders a note.
+    void setAlgorithm (int index)              { algorithmIndex = juce::jlimit (0, numAlgorithms - 1, index); }
+    int getAlgorithmIndex() const noexcept     { return algorithmIndex; }
+
+    // A bright electric piano. Only read from the audio thread.
+    const FmPatch& getPatch() const noexcept   { return patch; }
+
+    // Allocates the lanes for blocks of up to maximumBlockSize lane samples.
+    // Nothing grows on the audio thread, so blocks must never be longer.
+    void prepare (int maximumBlockSize)
+    {
+        blockCapacity = maximumBlockSize;
+        output.assign (groups.size() * FmLaneGroup::numLanes * (size_t) maximumBlockSize, 0.0f);
+    }
+
+    //==============================================================================
+    // Called before the synth renders a block whose lane samples start at startSample.
+    void beginBlock (int startSample, int numSamples) noexcept
+    {
+        jassert (startSample + numSamples <= blockCapacity);
+        juce::ignoreUnused (numSamples);
+
+        renderedUpTo = startSample;
+        blockStart = startSample;
+    }
+
+    void renderUpTo (int endSample)
+    {
+        if (endSample <= renderedUpTo)
+            return;
+
+        auto& kernels = RenderKernels::getActive();
+        auto& algorithm = updateAlgorithm();
+        auto numSamples = endSample - renderedUpTo;
+        constexpr int groupSize = FmLaneGroup::numLanes;
+
+        for (int g = 0; g < (int) groups.size(); ++g)
+        {
+            auto firstLane = g * groupSize;
+            auto numInGroup = juce::jmin (groupSize, numLanes - firstLane);
+            auto anyActive = false;
+
+            for (int l = 0; l < numInGroup; ++l)
+                anyActive = anyActive || states[(size_t) (firstLane + l)] != LaneState::idle;
+
+            if (! anyActive)
+                continue;
+
+            auto& group = groups[(size_t) g];
+            kernels.fm (getGroupOutput (g) + renderedUpTo * groupSize, numSamples, group, algorithm);
+
+            for (int l = 0; l < numInGroup; ++l)
+            {
+                auto& state = states[(size_t) (firstLane + l)];
+
+                if (state == LaneState::released && isSilent (group, l, algorithm))
+                    state = LaneState::finished;
+            }
+        }
+
+        renderedUpTo = endSample;
+    }
+
+    // Copies samples of one lane that renderUpTo() has already produced.
+    void copyLane (int lane, float* dest, int startSample, int numSamples) const noexcept
+    {
+        jassert (startSample >= blockStart && startSample + numSamples <= renderedUpTo);
+
+        constexpr int groupSize = FmLaneGroup::numLanes;
+        auto* src = getGroupOutput (lane / groupSize) + startSample * groupSize + lane % groupSize;
+
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = src[i * groupSize];
+    }
+
+    //==============================================================================
+    // The modulators' peaks follow the velocity, which sets the brightness.
+    // gain, from the note response, only scales the carriers, so the curves
+    // change a note's level and leave its timbre alone.
+    void startLane (int lane, double frequency, float velocity, float gain, double sampleRate)
+    {
+        auto& group = groups[(size_t) (lane / FmLaneGroup::numLanes)];
+        auto l = lane % FmLaneGroup::numLanes;
+        auto& algorithm = updateAlgorithm();
+
+        levels[(size_t) lane] = { gain, velocity };
+
+        for (int op = 0; op < FmLaneGroup::numOperators; ++op)
+        {
+            auto& o = patch.operators[op];
+            auto peak = o.level * getScale (lane, op, algorithm);
+            auto cyclesPerSample = juce::jmin (0.49, frequency * o.ratio / sampleRate);
+
+            group.phase[op][l] = 0;
+            group.increment[op][l] = (juce::uint32) (cyclesPerSample * 4294967296.0);
+            group.envelope[op][l] = peak;
+            group.target[op][l] = peak * o.sustain;
+            group.coefficient[op][l] = getCoefficient (o.decaySeconds, sampleRate);
+        }
+
+        group.feedback[l] = patch.feedback;
+        group.history[0][l] = group.history[1][l] = 0.0f;
+        states[(size_t) lane] = LaneState::held;
+    }
+
+    void releaseLane (int lane, double sampleRate)
+    {
+        auto& group = groups[(size_t) (lane / FmLaneGroup::numLanes)];
+        auto l = lane % FmLaneGroup::numLanes;
+
+        for (int op = 0; op < FmLaneGroup::numOperators; ++op)
+        {
+            group.target[op][l] = 0.0f;
+            group.coefficient[op][l] = getCoefficient (patch.operators[op].releaseSeconds, sampleRate);
+        }
+
+        if (states[(size_t) lane] == LaneState::held)
+            states[(size_t) lane] = LaneState::released;
+    }
+
+    void stopLane (int lane)
+    {
+        auto& group = groups[(size_t) (lane / FmLaneGroup::numLanes)];
+        auto l = lane % FmLaneGroup::numLanes;
+
+        for (int op = 0; op < FmLaneGroup::numOperators; ++op)
+            group.envelope[op][l] = group.target[op][l] = 0.0f;
+
+        states[(size_t) lane] = LaneState::idle;
+    }
+
+    bool isLaneActive (int lane) const noexcept     { return states[(size_t) lane] != LaneState::idle; }
+    bool hasLaneFinished (int lane) const noexcept  { return states[(size_t) lane] == LaneState::finished; }
+
+    bool isAnyLaneActive() const noexcept
+    {
+        return std::any_of (states.begin(), states.end(), [] (LaneState s) { return s != LaneState::idle; });
+    }
+
+private:
+    //==============================================================================
+    enum class LaneState : juce::uint8
+    {
+        idle,
+        held,
+        released,
+        finished   // released and silent; the voice frees it once it's mixed the last samples
+    };
+
+    // What a lane's operator peaks were scaled by at note-on, kept so that an
+    // algorithm change can rescale them.
+    struct LaneLevels
+    {
+        float carrier = 0.0f, modulator = 0.0f;
+    };
+
+    static constexpr float carrierGain = 0.3f, silenceThreshold = 1.0e-5f;
+
+    float getScale (int lane, int op, const FmAlgorithm& algorithm) const noexcept
+    {
+        if (((algorithm.carriers >> op) & 1) == 0)
+            return levels[(size_t) lane].modulator;
+
+        auto numCarriers = juce::BigInteger ((int) algorithm.carriers).countNumberOfSetBits();
+        return levels[(size_t) lane].carrier * carrierGain / (float) numCarriers;
+    }
+
+    // Picks up a new algorithm on the audio thread. An operator's envelope and
+    // target are scaled together, so its segment carries on from where it was
+    // at the level it would have started at as a carrier or a modulator.
+    const FmAlgorithm& updateAlgorithm() noexcept
+    {
+        auto index = algorithmIndex.load();
+
+        if (index == appliedAlgorithm)
+            return getAlgorithm (index);
+
+        auto& from = getAlgorithm (appliedAlgorithm);
+        auto& to = getAlgorithm (index);
+        appliedAlgorithm = index;
+
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            if (states[(size_t) lane] == LaneState::idle)
+                continue;
+
+            auto& group = groups[(size_t) (lane / FmLaneGroup::numLanes)];
+            auto l = lane % FmLaneGroup::numLanes;
+
+            for (int op = 0; op < FmLaneGroup::numOperators; ++op)
+            {
+                auto oldScale = getScale (lane, op, from);
+                auto ratio = oldScale > 0.0f ? getScale (lane, op, to) / oldScale : 0.0f;
+
+                group.envelope[op][l] *= ratio;
+                group.target[op][l] *= ratio;
+            }
+
+            // A lane that went silent under the old carriers may be audible
+            // under the new ones.
+            if (states[(size_t) lane] == LaneState::finished)
+                states[(size_t) lane] = LaneState::released;
+        }
+
+        return to;
+    }
+
+    // Per-sample coefficient for an exponential segment with the given time constant.
+    static float getCoefficient (float seconds, double sampleRate)
+    {
+        return (float) std::exp (-1.0 / (juce::jmax (0.001, (double) seconds) * sampleRate));
+    }
+
+    static bool isSilent (const FmLaneGroup& group, int l, const FmAlgorithm& algorithm)
+    {
+        for (int op = 0; op < FmLaneGroup::numOperators; ++op)
+            if (((algorithm.carriers >> op) & 1) != 0 && std::abs (group.envelope[op][l]) > silenceThreshold)
+                return false;
+
+        return true;
+    }
+
+    float* getGroupOutput (int g) noexcept               { return output.data() + (size_t) g * FmLaneGroup::numLanes * (size_t) blockCapacity; }
+    const float* getGroupOutput (int g) const noexcept   { return output.data() + (size_t) g * FmLaneGroup::numLanes * (size_t) blockCapacity; }
+
+    //==============================================================================
+    const int numLanes;
+    std::vector<FmLaneGroup> groups;
+    std::vector<LaneState> states;
+    std::vector<LaneLevels> levels;
+    std::vector<float> output;
+    int blockCapacity = 0, blockStart = 0, renderedUpTo = 0;
+
+    std::atomic<int> algorithmIndex { 0 };
+    int appliedAlgorithm = 0;
+
+    FmPatch patch { { { 1.0f, 1.0f,  1.5f, 0.3f,  0.3f },
+                      { 1.0f, 0.35f, 0.8f, 0.2f,  0.3f },
+                      { 2.0f, 0.25f, 0.6f, 0.25f, 0.3f },
+                      { 3.0f, 0.15f, 0.4f, 0.2f,  0.2f } },
+                    0.1f };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FmVoiceBank)
+};
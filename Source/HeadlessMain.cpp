@@ -0,0 +1,226 @@
+/*
+  ==============================================================================
+
+    Entry point for the headless renderer. It shares the voice engine with
+    the GUI app, and is what the PGO training run and golden checks use.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "SynthUsingMidiInput.h"
+#include "OfflineRenderer.h"
+#include "Benchmarks.h"
+
+//==============================================================================
+static double renderAndTime (const RenderScenario& scenario, const RenderSettings& settings,
+                             int repeats, juce::AudioBuffer<float>& result)
+{
+    auto start = juce::Time::getMillisecondCounterHiRes();
+
+    for (int i = 0; i < repeats; ++i)
+        result = OfflineRenderer::render (scenario, settings);
+
+    return (juce::Time::getMillisecondCounterHiRes() - start) * 0.001;
+}
+
+static void printTiming (const RenderScenario& scenario, double seconds, int repeats)
+{
+    auto audioSeconds = scenario.lengthSeconds * repeats;
+
+    std::cout << scenario.name << ": " << juce::String (seconds * 1000.0, 2) << " ms for "
+              << juce::String (audioSeconds, 2) << " s of audio ("
+              << juce::String (audioSeconds / juce::jmax (seconds, 1.0e-9), 1) << "x realtime, kernels "
+              << RenderKernels::getActive().name << ")" << std::endl;
+}
+
+static RenderScenario loadScenarioOrFail (const juce::File& file)
+{
+    RenderScenario scenario;
+
+    if (! OfflineRenderer::loadMidiFile (file, scenario))
+        juce::ConsoleApplication::fail ("Couldn't read MIDI file " + file.getFullPathName());
+
+    return scenario;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ArgumentList arguments (argc, argv);
+
+    if (arguments.containsOption ("--isa"))
+    {
+        RenderKernels::Level level;
+        auto name = arguments.getValueForOption ("--isa");
+
+        if (! RenderKernels::levelFromName (name, level) || ! RenderKernels::setActiveLevel (level))
+        {
+            std::cerr << "Render kernels '" << name << "' aren't available on this CPU" << std::endl;
+            return 1;
+        }
+    }
+
+    juce::ConsoleApplication app;
+    app.addHelpCommand ("--help|-h", "Usage:", true);
+
+    app.addCommand ({ "--golden-render",
+                      "--golden-render=<dir>",
+                      "Writes the golden manifest of the built-in scenarios, and WAVs of them, to <dir>.", {},
+                      [] (const juce::ArgumentList& args)
+                      {
+                          auto dir = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--golden-render"));
+
+                          if (OfflineRenderer::runGolden (dir, true) != 0)
+                              juce::ConsoleApplication::fail ("Couldn't write the reference renders");
+                      }});
+
+    app.addCommand ({ "--golden-verify",
+                      "--golden-verify=<dir>",
+                      "Checks every supported kernel level against the manifest in <dir>.", {},
+                      [] (const juce::ArgumentList& args)
+                      {
+                          auto dir = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--golden-verify"));
+                          if (OfflineRenderer::runGolden (dir, false) != 0)
+                              juce::ConsoleApplication::fail ("Golden check failed");
+                      }});
+
+    app.addCommand ({ "--render",
+                      "--render=<file.mid> [--output=<file.wav>] [--repeat=<n>] [--trace=<file.json>]",
+                      "Renders a MIDI file and reports how long it took. --trace needs a build with SYNTH_ENABLE_TRACE.", {},
+                      [] (const juce::ArgumentList& args)
+                      {
+                          auto scenario = loadScenarioOrFail (args.getExistingFileForOption ("--render"));
+                          auto repeats = juce::jmax (1, args.getValueForOption ("--repeat").getIntValue());
+
+                          RenderSettings settings;
+                          juce::AudioBuffer<float> result;
+                          printTiming (scenario, renderAndTime (scenario, settings, repeats, result), repeats);
+
+                          if (args.containsOption ("--output"))
+                              if (! OfflineRenderer::writeWavFile (args.getFileForOption ("--output"), result, settings.sampleRate))
+                                  juce::ConsoleApplication::fail ("Couldn't write the output file");
+
+                          if (args.containsOption ("--trace"))
+                          {
+                             #if SYNTH_TRACE
+                              if (! Trace::writeChromeJson (args.getFileForOption ("--trace")))
+                                  juce::ConsoleApplication::fail ("Couldn't write the trace file");
+                             #else
+                              juce::ConsoleApplication::fail ("This build has no trace scopes; configure with -DSYNTH_ENABLE_TRACE=ON");
+                             #endif
+                          }
+                      }});
+
+    app.addCommand ({ "--train",
+                      "--train [<file.mid>...]",
+                      "Profile-guided optimisation training run over the built-in scenarios and any MIDI files given.", {},
+                      [] (const juce::ArgumentList& args)
+                      {
+                          auto scenarios = OfflineRenderer::createScenarios();
+
+                          for (auto& arg : args.arguments)
+                              if (arg.text.endsWithIgnoreCase (".mid"))
+                                  scenarios.add (loadScenarioOrFail (arg.resolveAsExistingFile()));
+
+                          RenderSettings settings;
+                          juce::AudioBuffer<float> result;
+
+                          for (auto& scenario : scenarios)
+                              printTiming (scenario, renderAndTime (scenario, settings, 8, result), 8);
+                      }});
+
+    app.addCommand ({ "--benchmark-reverb",
+                      "--benchmark-reverb [--ir=<file.wav>]",
+                      "Measures the master reverb's cost per channel at common buffer sizes.", {},
+                      [] (const juce::ArgumentList& args)
+                      {
+                          Benchmarks::runReverb (args.containsOption ("--ir") ? args.getExistingFileForOption ("--ir")
+                                                                             : juce::File());
+                      }});
+
+    app.addCommand ({ "--benchmark-oversampling",
+                      "--benchmark-oversampling",
+                      "Measures the voice rendering cost at each oversampling factor.", {},
+                      [] (const juce::ArgumentList&)
+                      {
+                          Benchmarks::runOversampling();
+                      }});
+
+    app.addCommand ({ "--benchmark-fm",
+                      "--benchmark-fm [--voices=<n>]",
+                      "Measures the cost of holding down every FM voice, 64 by default.", {},
+                      [] (const juce::ArgumentList& args)
+                      {
+                          auto numVoices = args.containsOption ("--voices") ? args.getValueForOption ("--voices").getIntValue() : 64;
+                          Benchmarks::runFm (juce::jmax (1, numVoices));
+                      }});
+
+    app.addCommand ({ "--benchmark-additive",
+                      "--benchmark-additive [--voices=<n>]",
+                      "Measures the cost of holding down additive voices, 8 by default.", {},
+                      [] (const juce::ArgumentList& args)
+                      {
+                          auto numVoices = args.containsOption ("--voices") ? args.getValueForOption ("--voices").getIntValue() : 8;
+                          Benchmarks::runAdditive (juce::jmax (1, numVoices));
+                      }});
+
+    app.addCommand ({ "--benchmark-kernels",
+                      "--benchmark-kernels",
+                      "Times each render kernel level this CPU supports against the reference kernels, and prints "
+                      "the SNR of its output against theirs, kernel by kernel and over the golden scenarios.", {},
+                      [] (const juce::ArgumentList&)
+                      {
+                          Benchmarks::runKernels();
+                      }});
+
+    app.addCommand ({ "--benchmark-trace",
+                      "--benchmark-trace",
+                      "Measures what the trace scopes cost, in a build configured with -DSYNTH_ENABLE_TRACE=ON.", {},
+                      [] (const juce::ArgumentList&)
+                      {
+                          Benchmarks::runTraceOverhead();
+                      }});
+
+    app.addCommand ({ "--benchmark-presets",
+                      "--benchmark-presets",
+                      "Measures how long a preset takes to parse, prepare and apply.", {},
+                      [] (const juce::ArgumentList&)
+                      {
+                          Benchmarks::runPresetRecall();
+                      }});
+
+    app.addCommand ({ "--benchmark-callback",
+                      "--benchmark-callback",
+                      "Measures the fixed cost of an audio callback with nothing playing, with low-latency mode off and on.", {},
+                      [] (const juce::ArgumentList&)
+                      {
+                          Benchmarks::runCallbackOverhead();
+                      }});
+
+    app.addCommand ({ "--benchmark-startup",
+                      "--benchmark-startup [--no-warm-up]",
+                      "Compares the first block after prepareToPlay with the median block. Run once with and once "
+                      "without --no-warm-up, each in a fresh process.", {},
+                      [] (const juce::ArgumentList& args)
+                      {
+                          Benchmarks::runStartup (! args.containsOption ("--no-warm-up"));
+                      }});
+
+    app.addCommand ({ "--latency-loopback",
+                      "--latency-loopback [--notes=<n>] [--block=<n>] [--realtime [--rt-priority=<n>] [--cpus=<list>] [--no-mlock]]",
+                      "Plays notes through a virtual MIDI port into the engine, driven by a dummy audio device, "
+                      "and prints the MIDI-to-audio latency percentiles. --realtime runs the audio thread with "
+                      "SCHED_FIFO, CPU pinning and locked memory, and reports what couldn't be had.", {},
+                      [] (const juce::ArgumentList& args)
+                      {
+                          auto numNotes = args.containsOption ("--notes") ? args.getValueForOption ("--notes").getIntValue() : 100;
+                          auto blockSize = args.containsOption ("--block") ? args.getValueForOption ("--block").getIntValue() : 256;
+
+                          if (! Benchmarks::runLatencyLoopback (juce::jmax (1, numNotes), juce::jlimit (16, 4096, blockSize),
+                                                                RealtimeSetup::optionsFromArguments (args)))
+                              juce::ConsoleApplication::fail ("Latency loopback failed");
+                      }});
+
+    return app.findAndRunCommand (arguments);
+}
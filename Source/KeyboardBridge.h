@@ -0,0 +1,228 @@
+/*
+  ==============================================================================
+
+    Connects the GUI's juce::MidiKeyboardState to the engine without the
+    audio thread ever touching it.
+
+    Notes played on screen go into a port of the engine's MidiInputMerger,
+    the same lock-free path as a hardware input. The notes the engine takes
+    from every input go the other way through a NoteDisplayFeed, a lock-free
+    FIFO that a timer on the message thread drains into the keyboard state
+    so the keys light up.
+
+    The timer runs at a capped frame rate and coalesces what it drains: only
+    keys whose state differs at the end of a frame are changed, so a fast
+    run of notes costs one repaint per changed key per frame rather than
+    one per note. MidiKeyboardComponent then repaints just those keys. Key
+    feedback can also be switched off entirely for performance.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <bitset>
+
+//==============================================================================
+// Note-ons and note-offs taken by the audio thread, for showing on a
+// keyboard. Does nothing until a reader enables it.
+class NoteDisplayFeed
+{
+public:
+    static constexpr int queueSize = 512;
+
+    struct Note
+    {
+        juce::uint8 channel, note, velocity;   // a velocity of 0 is a note-off
+    };
+
+    NoteDisplayFeed() = default;
+
+    void setEnabled (bool shouldBeEnabled)      { enabled = shouldBeEnabled; }
+    bool isEnabled() const noexcept             { return enabled.load (std::memory_order_relaxed); }
+
+    // Audio thread. Notes that don't fit are dropped; they only affect the
+    // display.
+    void push (const juce::MidiBuffer& midi) noexcept
+    {
+        for (const auto metadata : midi)
+        {
+            if (metadata.numBytes != 3)
+                continue;
+
+            auto* data = metadata.data;
+            auto type = data[0] & 0xf0;
+
+            if (type != 0x90 && type != 0x80)
+                continue;
+
+            const juce::AbstractFifo::ScopedWrite write (fifo, 1);
+
+            if (write.blockSize1 == 0)
+                return;
+
+            notes[(size_t) write.startIndex1] = { (juce::uint8) ((data[0] & 0x0f) + 1), data[1],
+                                                  (juce::uint8) (type == 0x90 ? data[2] : 0) };
+        }
+    }
+
+    // The reading thread.
+    template <typename Callback>
+    void drain (Callback&& callback)
+    {
+        const juce::AbstractFifo::ScopedRead read (fifo, fifo.getNumReady());
+
+        for (int i = 0; i < read.blockSize1; ++i)
+            callback (notes[(size_t) (read.startIndex1 + i)]);
+
+        for (int i = 0; i < read.blockSize2; ++i)
+            callback (notes[(size_t) (read.startIndex2 + i)]);
+    }
+
+private:
+    juce::AbstractFifo fifo { queueSize };
+    std::array<Note, (size_t) queueSize> notes;
+    std::atomic<bool> enabled { false };
+
+    JUCE_DECLARE_NON_COPYABLE (NoteDisplayFeed)
+};
+
+//==============================================================================
+// Message thread only.
+class KeyboardBridge   : private juce::MidiKeyboardState::Listener,
+                         private juce::Timer
+{
+public:
+    KeyboardBridge (juce::MidiKeyboardState& stateToUse, MidiInputMerger& mergerToUse, NoteDisplayFeed& feedToUse)
+        : state (stateToUse), merger (mergerToUse), feed (feedToUse)
+    {
+        port = merger.openPort (portName);
+        state.addListener (this);
+        setKeyFeedbackEnabled (true);
+    }
+
+    ~KeyboardBridge() override
+    {
+        stopTimer();
+        feed.setEnabled (false);
+        state.removeListener (this);
+        merger.closePort (portName);
+    }
+
+    static constexpr const char* portName = "On-screen keyboard";
+    static constexpr int defaultFrameRate = 30;
+
+    // How often the keys can change on screen.
+    void setFrameRate (int framesPerSecond)
+    {
+        frameRate = juce::jlimit (1, 60, framesPerSecond);
+
+        if (isTimerRunning())
+            startTimerHz (frameRate);
+    }
+
+    // With feedback off the engine stops feeding notes back at all, and any
+    // keys it had lit are released.
+    void setKeyFeedbackEnabled (bool shouldBeEnabled)
+    {
+        feed.setEnabled (shouldBeEnabled);
+
+        if (shouldBeEnabled)
+        {
+            startTimerHz (frameRate);
+            return;
+        }
+
+        stopTimer();
+        feed.drain ([] (const NoteDisplayFeed::Note&) {});
+
+        const juce::ScopedValueSetter<bool> svs (showingEngineNotes, true);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            for (int note = 0; note < 128; ++note)
+                if (shown[(size_t) channel][(size_t) note])
+                    state.noteOff (channel + 1, note, 0.0f);
+
+        for (auto& keys : shown)
+            keys.reset();
+    }
+
+    bool isKeyFeedbackEnabled() const noexcept    { return isTimerRunning(); }
+
+private:
+    void handleNoteOn (juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        send (juce::MidiMessage::noteOn (midiChannel, midiNoteNumber, velocity));
+    }
+
+    void handleNoteOff (juce::MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        send (juce::MidiMessage::noteOff (midiChannel, midiNoteNumber, velocity));
+    }
+
+    // Notes that are only being shown aren't sent back to the engine.
+    void send (juce::MidiMessage message)
+    {
+        if (showingEngineNotes || port == nullptr)
+            return;
+
+        message.setTimeStamp (juce::Time::getMillisecondCounterHiRes() * 0.001);
+        port->handleIncomingMidiMessage (nullptr, message);
+    }
+
+    // Works out where every key ends up after this frame's notes, then
+    // changes only the keys that differ from what is shown.
+    void timerCallback() override
+    {
+        auto target = shown;
+        float velocities[numChannels][128];
+        auto anyNotes = false;
+
+        feed.drain ([&] (const NoteDisplayFeed::Note& n)
+        {
+            auto channel = (size_t) (n.channel - 1);
+            target[channel][n.note & 127] = n.velocity > 0;
+            velocities[channel][n.note & 127] = n.velocity / 127.0f;
+            anyNotes = true;
+        });
+
+        if (! anyNotes)
+            return;
+
+        const juce::ScopedValueSetter<bool> svs (showingEngineNotes, true);
+
+        for (size_t channel = 0; channel < (size_t) numChannels; ++channel)
+        {
+            auto changed = target[channel] ^ shown[channel];
+
+            if (changed.none())
+                continue;
+
+            for (size_t note = 0; note < 128; ++note)
+            {
+                if (! changed[note])
+                    continue;
+
+                if (target[channel][note])
+                    state.noteOn ((int) channel + 1, (int) note, velocities[channel][note]);
+                else
+                    state.noteOff ((int) channel + 1, (int) note, 0.0f);
+            }
+        }
+
+        shown = target;
+    }
+
+    //==============================================================================
+    juce::MidiKeyboardState& state;
+    MidiInputMerger& merger;
+    NoteDisplayFeed& feed;
+    juce::MidiInputCallback* port = nullptr;
+    bool showingEngineNotes = false;
+
+    static constexpr int numChannels = 16;
+    std::array<std::bitset<128>, numChannels> shown;
+    int frameRate = defaultFrameRate;
+
+    JUCE_DECLARE_NON_COPYABLE (KeyboardBridge)
+};
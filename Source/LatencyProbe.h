@@ -0,0 +1,157 @@
+/*
+  ==============================================================================
+
+    Measures MIDI-to-audio latency: from a note-on arriving in a MIDI input's
+    callback to the block holding its first non-zero sample being returned
+    from getNextAudioBlock. The time the device then takes to play that
+    block isn't included.
+
+    The merger hands the probe each note-on it takes, with the tick count at
+    which it arrived. After the block is rendered, the probe looks for sound
+    at or after the note's position, in this block or the following ones.
+    Notes are matched in order against the first sound after them, so this
+    only means something when notes are played one at a time into silence,
+    as the loopback test does.
+
+    Results go through a lock-free FIFO; percentiles are worked out on the
+    reading thread.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+class LatencyProbe
+{
+public:
+    static constexpr int maxPending = 64, maxResults = 4096;
+    static constexpr int maxBlocksToWait = 1000;
+
+    struct Percentiles
+    {
+        int numMeasured = 0;
+        juce::uint64 numUnmatched = 0;
+        double p50Ms = 0.0, p99Ms = 0.0, maxMs = 0.0;
+    };
+
+    LatencyProbe() = default;
+
+    //==============================================================================
+    // Audio thread: a note-on that arrived at arrivalTicks was placed at this
+    // position in the block about to be rendered.
+    void noteOnTaken (juce::int64 arrivalTicks, int position) noexcept
+    {
+        if (numPending == maxPending)
+        {
+            ++numUnmatched;
+            return;
+        }
+
+        pending[(size_t) ((firstPending + numPending++) % maxPending)] = { arrivalTicks, position, 0 };
+    }
+
+    // Audio thread, once the block has been rendered and is about to be
+    // returned.
+    void blockRendered (const juce::AudioBuffer<float>& buffer, int startSample, int numSamples) noexcept
+    {
+        if (numPending == 0)
+            return;
+
+        auto now = juce::Time::getHighResolutionTicks();
+
+        while (numPending > 0)
+        {
+            auto& note = pending[(size_t) firstPending];
+
+            if (! hasSound (buffer, startSample + note.position, numSamples - note.position))
+            {
+                note.position = 0;
+
+                if (++note.blocksWaited < maxBlocksToWait)
+                    break;
+
+                ++numUnmatched;
+            }
+            else
+            {
+                const juce::AbstractFifo::ScopedWrite write (results, 1);
+
+                if (write.blockSize1 > 0)
+                    resultTicks[(size_t) write.startIndex1] = now - note.arrivalTicks;
+            }
+
+            firstPending = (firstPending + 1) % maxPending;
+            --numPending;
+        }
+    }
+
+    //==============================================================================
+    // Takes whatever has been measured since the last call into the history
+    // and returns the percentiles over all of it. One reading thread only.
+    Percentiles getPercentiles()
+    {
+        const juce::AbstractFifo::ScopedRead read (results, results.getNumReady());
+
+        for (int i = 0; i < read.blockSize1; ++i)
+            history.add (toMilliseconds (resultTicks[(size_t) (read.startIndex1 + i)]));
+
+        for (int i = 0; i < read.blockSize2; ++i)
+            history.add (toMilliseconds (resultTicks[(size_t) (read.startIndex2 + i)]));
+
+        Percentiles p;
+        p.numMeasured = history.size();
+        p.numUnmatched = numUnmatched.load();
+
+        if (history.isEmpty())
+            return p;
+
+        auto sorted = history;
+        sorted.sort();
+
+        auto at = [&sorted] (double fraction) { return sorted[juce::jmin (sorted.size() - 1, (int) (fraction * sorted.size()))]; };
+
+        p.p50Ms = at (0.5);
+        p.p99Ms = at (0.99);
+        p.maxMs = sorted.getLast();
+        return p;
+    }
+
+private:
+    struct PendingNote
+    {
+        juce::int64 arrivalTicks;
+        int position, blocksWaited;
+    };
+
+    static bool hasSound (const juce::AudioBuffer<float>& buffer, int start, int num) noexcept
+    {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        {
+            auto* data = buffer.getReadPointer (ch, start);
+
+            for (int i = 0; i < num; ++i)
+                if (data[i] != 0.0f)
+                    return true;
+        }
+
+        return false;
+    }
+
+    static double toMilliseconds (juce::int64 ticks)
+    {
+        return juce::Time::highResolutionTicksToSeconds (ticks) * 1000.0;
+    }
+
+    //==============================================================================
+    std::array<PendingNote, (size_t) maxPending> pending;
+    int firstPending = 0, numPending = 0;
+
+    juce::AbstractFifo results { maxResults };
+    std::array<juce::int64, (size_t) maxResults> resultTicks;
+    std::atomic<juce::uint64> numUnmatched { 0 };
+
+    juce::Array<double> history;
+
+    JUCE_DECLARE_NON_COPYABLE (LatencyProbe)
+};
@@ -8,6 +8,7 @@
 
 #include <JuceHeader.h>
 #include "SynthUsingMidiInput.h"
+#include "OfflineRenderer.h"
 
 class Application    : public juce::JUCEApplication
 {
@@ -20,7 +21,34 @@ public:
 
     void initialise (const juce::String&) override
     {
-        mainWindow.reset (new MainWindow ("SynthUsingMidiInputTutorial", new MainContentComponent, *this));
+        juce::ArgumentList args (getApplicationName(), getCommandLineParameterArray());
+
+        if (args.containsOption ("--isa"))
+        {
+            RenderKernels::Level level;
+            auto name = args.getValueForOption ("--isa");
+
+            if (! RenderKernels::levelFromName (name, level) || ! RenderKernels::setActiveLevel (level))
+            {
+                std::cerr << "Render kernels '" << name << "' aren't available on this CPU" << std::endl;
+                setApplicationReturnValue (1);
+                quit();
+                return;
+            }
+        }
+
+        if (args.containsOption ("--golden-render|--golden-verify"))
+        {
+            auto updateReferences = args.containsOption ("--golden-render");
+            auto directory = juce::File::getCurrentWorkingDirectory()
+                                 .getChildFile (args.getValueForOption ("--golden-render|--golden-verify"));
+            setApplicationReturnValue (OfflineRenderer::runGolden (directory, updateReferences));
+            quit();
+            return;
+        }
+
+        mainWindow.reset (new MainWindow ("SynthUsingMidiInputTutorial",
+                                          new MainContentComponent (RealtimeSetup::optionsFromArguments (args)), *this));
     }
 
     void shutdown() override                         { mainWindow = nullptr; }
@@ -0,0 +1,826 @@
+/*
+  ==============================================================================
+
+    Convolution reverb on the master bus.
+
+    The impulse response is split in two. Its head, the first two tail
+    partitions' worth of samples, goes through juce::dsp::Convolution's
+    zero-latency uniform engine on the audio thread, so the reverb adds no
+    latency. The rest is convolved by uniform partitioned overlap-save on a
+    background thread, one partition of input at a time: a partition is
+    handed over as soon as it has filled, and its output isn't needed until
+    a whole partition later, which is the time the thread has to do it in.
+
+    The audio thread never waits for the background thread, which runs at a
+    lower priority. If a partition hasn't been finished by the time its
+    output is due, the audio thread does it itself, or works out its own
+    copy if the thread is part way through it. Only when the thread is
+    further behind than that is the partition's tail left out, which is
+    counted as an underrun.
+
+    Impulse responses are read, resampled, normalised and transformed on a
+    loader thread. The head is handed to Convolution, which crossfades it
+    in; the tail is picked up at the start of the next partition and
+    crossfaded in over that partition.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+class MasterReverb   : private juce::Thread
+{
+public:
+    static constexpr int minTailPartitionSize = 1024;
+    static constexpr double maxImpulseResponseSeconds = 8.0;
+
+    MasterReverb()
+        : juce::Thread ("Reverb tail")
+    {
+    }
+
+    ~MasterReverb() override
+    {
+        loader.removeAllJobs (true, 4000);
+        stopThread (2000);
+    }
+
+    void setEnabled (bool shouldBeEnabled)   { enabled = shouldBeEnabled; }
+    bool isEnabled() const noexcept          { return enabled; }
+
+    void setWetLevel (float newLevel)        { wetLevel = newLevel; }
+    float getWetLevel() const noexcept       { return wetLevel; }
+
+    // Reads the file on the loader thread. Longer responses are cut short at
+    // maxImpulseResponseSeconds.
+    void loadImpulseResponse (const juce::File& file)
+    {
+        loader.addJob ([this, file]
+        {
+            juce::AudioFormatManager formats;
+            formats.registerBasicFormats();
+
+            std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (file));
+
+            if (reader == nullptr)
+                return;
+
+            auto maxLength = (juce::int64) (maxImpulseResponseSeconds * reader->sampleRate);
+            auto length = (int) juce::jmin (reader->lengthInSamples, maxLength);
+            juce::AudioBuffer<float> buffer ((int) juce::jmin (2u, reader->numChannels), length);
+            reader->read (&buffer, 0, length, 0, true, buffer.getNumChannels() > 1);
+
+            setSource (std::move (buffer), reader->sampleRate);
+            rebuild();
+        });
+    }
+
+    void loadImpulseResponse (juce::AudioBuffer<float>&& buffer, double bufferSampleRate)
+    {
+        auto shared = std::make_shared<juce::AudioBuffer<float>> (std::move (buffer));
+
+        loader.addJob ([this, shared, bufferSampleRate]
+        {
+            setSource (std::move (*shared), bufferSampleRate);
+            rebuild();
+        });
+    }
+
+    bool hasImpulseResponse() const noexcept    { return convolution.getCurrentIRSize() > 0; }
+
+    // Message thread, while the audio isn't running.
+    void prepare (double sampleRate, int maximumBlockSize, int numChannels)
+    {
+        stopThread (2000);
+
+        juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32) maximumBlockSize, (juce::uint32) numChannels };
+
+        convolution.prepare (spec);
+        dryWet.prepare (spec);
+        dryWet.setWetLatency (0.0f);
+
+        // A partition at least as long as a block, so that each block hands
+        // over at most one and the thread always has a partition's time.
+        auto partitionSize = juce::jmax (minTailPartitionSize, juce::nextPowerOfTwo (maximumBlockSize));
+
+        {
+            const juce::ScopedLock sl (sourceLock);
+            targetSampleRate = sampleRate;
+            tailPartitionSize = partitionSize;
+        }
+
+        tail.prepare (partitionSize, numChannels, getNumPartitions (sampleRate, partitionSize));
+        prepared = true;
+
+        loader.addJob ([this] { rebuild(); });
+        startThread (7);
+    }
+
+    // Message thread, while the audio isn't running.
+    void reset()
+    {
+        stopThread (2000);
+        convolution.reset();
+        dryWet.reset();
+        tail.reset();
+
+        if (prepared)
+            startThread (7);
+    }
+
+    // With the thread off, every tail partition is done on the audio thread
+    // as its output comes due. The output is the same either way.
+    void setTailThreadEnabled (bool shouldBeEnabled)    { tailThreadEnabled = shouldBeEnabled; }
+
+    struct Stats
+    {
+        double tailMicros = 0.0;                        // spent on tail partitions, on either thread
+        juce::int64 numPartitions = 0, numOnAudioThread = 0;
+        juce::int64 numUnderruns = 0;                   // partitions whose tail was left out
+    };
+
+    Stats getStats() const noexcept
+    {
+        Stats s;
+        s.tailMicros = juce::Time::highResolutionTicksToSeconds (tail.ticksSpent.load()) * 1.0e6;
+        s.numPartitions = tail.computed.load();
+        s.numOnAudioThread = tail.numOnAudioThread.load();
+        s.numUnderruns = tail.numUnderruns.load();
+        return s;
+    }
+
+    void process (juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+    {
+        if (! prepared || ! enabled)
+            return;
+
+        SYNTH_TRACE_SCOPE ("reverb");
+
+        juce::dsp::AudioBlock<float> block (buffer);
+        auto subBlock = block.getSubBlock ((size_t) startSample, (size_t) numSamples);
+
+        dryWet.setWetMixProportion (wetLevel.load());
+        dryWet.pushDrySamples (subBlock);
+
+        tail.pushInput (buffer, startSample, numSamples);
+        convolution.process (juce::dsp::ProcessContextReplacing<float> (subBlock));
+        tail.addOutput (buffer, startSample, numSamples);
+
+        dryWet.mixWetSamples (subBlock);
+    }
+
+private:
+    //==============================================================================
+    // The tail of an impulse response: the spectrum of each partition, zero
+    // padded to twice its length, for each channel.
+    struct TailResponse
+    {
+        int partitionSize = 0, numPartitions = 0, numChannels = 0;
+        std::vector<float> spectra;    // [partition][channel][bin], as interleaved complex
+
+        // The last input partition convolved with it, once a newer response
+        // has taken over.
+        mutable std::atomic<juce::int64> lastPartition { std::numeric_limits<juce::int64>::max() };
+
+        float* getSpectrum (int partition, int channel) noexcept
+        {
+            return spectra.data() + ((size_t) partition * (size_t) numChannels + (size_t) channel) * (size_t) (partitionSize + 1) * 2;
+        }
+
+        const float* getSpectrum (int partition, int channel) const noexcept
+        {
+            return const_cast<TailResponse*> (this)->getSpectrum (partition, channel);
+        }
+    };
+
+    // Working space for one thread's convolution of a partition, so that the
+    // audio thread can work on one while the tail thread is on the same one.
+    struct Scratch
+    {
+        void prepare (int partitionSize)
+        {
+            transform.assign ((size_t) partitionSize * 4, 0.0f);
+            spectrum.assign ((size_t) (partitionSize + 1) * 2, 0.0f);
+            sum.assign (spectrum.size(), 0.0f);
+            previousSum.assign (spectrum.size(), 0.0f);
+            faded.assign ((size_t) partitionSize, 0.0f);
+        }
+
+        std::vector<float> transform, spectrum, sum, previousSum, faded;
+    };
+
+    //==============================================================================
+    // Uniform partitioned overlap-save convolution of everything after the
+    // head. Partition k of the input is convolved once it has filled, and
+    // comes out headLength samples after it started.
+    //
+    // The tail thread works through the partitions in order, claiming each
+    // one as it starts on it. The audio thread never waits for it: when a
+    // partition's output comes due and nobody has claimed it, the audio
+    // thread does it in place; if the tail thread is part way through it, the
+    // audio thread works out its own copy into a spare output; and if the
+    // tail thread is further behind than that, the partition's tail is left
+    // out and counted as an underrun.
+    struct TailConvolver
+    {
+        static constexpr int ringSize = 8;
+
+        void prepare (int newPartitionSize, int newNumChannels, int maxPartitions)
+        {
+            partitionSize = newPartitionSize;
+            numChannels = newNumChannels;
+            numBins = partitionSize + 1;
+            fdlSize = juce::jmax (1, maxPartitions);
+
+            fft = std::make_unique<juce::dsp::FFT> (juce::roundToInt (std::log2 (partitionSize * 2)));
+
+            inputs.assign ((size_t) (ringSize * numChannels * partitionSize), 0.0f);
+            outputs.assign ((size_t) (ringSize * numChannels * partitionSize), 0.0f);
+            spare.assign ((size_t) (numChannels * partitionSize), 0.0f);
+            history.assign ((size_t) (fdlSize * numChannels * numBins * 2), 0.0f);
+
+            for (auto* scratch : { &tailScratch, &audioScratch })
+                scratch->prepare (partitionSize);
+
+            // The active response stays, so that the one the loader builds for
+            // the new layout replaces it in the usual way; until then it no
+            // longer fits and the tail is silent.
+            reset();
+        }
+
+        // With the tail thread stopped.
+        void reset()
+        {
+            std::fill (inputs.begin(), inputs.end(), 0.0f);
+            std::fill (outputs.begin(), outputs.end(), 0.0f);
+            std::fill (history.begin(), history.end(), 0.0f);
+
+            for (auto& r : responses)
+            {
+                r.current = nullptr;
+                r.fadingFrom = nullptr;
+            }
+
+            position = 0;
+            posted = computed = claimed = due = 0;
+            outputPartition = -1;
+            audioPartition = -1;
+        }
+
+        //==============================================================================
+        // Audio thread, before the head overwrites the block. Never waits: if
+        // the tail thread is so far behind that it's still reading a slot being
+        // refilled here, it drops that partition when it gets to it.
+        void pushInput (const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+        {
+            auto numToCopy = juce::jmin (numChannels, buffer.getNumChannels());
+
+            for (int done = 0; done < numSamples;)
+            {
+                auto partition = position / partitionSize;
+                auto offset = (int) (position % partitionSize);
+                auto num = juce::jmin (numSamples - done, partitionSize - offset);
+
+                for (int ch = 0; ch < numToCopy; ++ch)
+                    std::copy (buffer.getReadPointer (ch, startSample + done),
+                               buffer.getReadPointer (ch, startSample + done) + num,
+                               getInput (partition, ch) + offset);
+
+                for (int ch = numToCopy; ch < numChannels; ++ch)
+                    std::fill (getInput (partition, ch) + offset, getInput (partition, ch) + offset + num, 0.0f);
+
+                done += num;
+                position += num;
+
+                if (offset + num == partitionSize)
+                    post (partition);
+            }
+        }
+
+        // Audio thread, after the head has been written.
+        void addOutput (juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+        {
+            auto numToAdd = juce::jmin (numChannels, buffer.getNumChannels());
+            auto headLength = (juce::int64) partitionSize * 2;
+            auto blockStart = position - numSamples;
+
+            for (int done = 0; done < numSamples;)
+            {
+                auto time = blockStart + done - headLength;
+
+                if (time < 0)
+                {
+                    done += (int) juce::jmin ((juce::int64) (numSamples - done), -time);
+                    continue;
+                }
+
+                auto partition = time / partitionSize;
+                auto offset = (int) (time % partitionSize);
+                auto num = juce::jmin (numSamples - done, partitionSize - offset);
+                auto source = prepareOutput (partition);
+
+                if (source != Source::none)
+                    for (int ch = 0; ch < numToAdd; ++ch)
+                        juce::FloatVectorOperations::add (buffer.getWritePointer (ch, startSample + done),
+                                                          (source == Source::spare ? getSpare (ch) : getOutput (partition, ch)) + offset,
+                                                          num);
+
+                done += num;
+            }
+        }
+
+        // Tail thread. Takes the next posted partition unless the audio thread
+        // already has. A partition whose output the audio thread has moved past
+        // only gets its spectrum worked out, for the partitions after it, and
+        // one whose input may have been overwritten is left out altogether.
+        // Returns true if there was a partition to take.
+        bool computeNext() noexcept
+        {
+            auto next = computed.load();
+
+            if (next >= posted.load (std::memory_order_acquire) || ! claimed.compare_exchange_strong (next, next + 1))
+                return false;
+
+            SYNTH_TRACE_SCOPE ("reverb tail");
+            auto startTicks = juce::Time::getHighResolutionTicks();
+
+            if (next + ringSize - 1 <= posted.load())
+                clearHistory (next);
+            else if (next < due.load())
+                transformInput (next, tailScratch, true);
+            else
+                compute (next, tailScratch, false);
+
+            ticksSpent += juce::Time::getHighResolutionTicks() - startTicks;
+            computed.store (next + 1);
+            return true;
+        }
+
+        //==============================================================================
+        enum class Source { primary, spare, none };
+
+        // Audio thread: where the output of this partition can be read from,
+        // working it out here if need be.
+        Source prepareOutput (juce::int64 partition) noexcept
+        {
+            if (partition == outputPartition)
+                return outputSource;
+
+            outputPartition = partition;
+            due.store (partition);
+            outputSource = Source::none;
+
+            if (computed.load() > partition)
+                return outputSource = Source::primary;
+
+            // Nobody has started it, so it's done here, in place.
+            auto expected = partition;
+
+            if (computed.load() == partition && claimed.compare_exchange_strong (expected, partition + 1))
+            {
+                compute (partition, audioScratch, false);
+                computed.store (partition + 1);
+                ++numOnAudioThread;
+                return outputSource = Source::primary;
+            }
+
+            if (computed.load() == partition)
+            {
+                // The tail thread is on it. Everything before it is in the
+                // history, so a copy can be worked out here without touching
+                // anything the tail thread is writing. The loader reads
+                // audioPartition to know which responses are still in use.
+                audioPartition.store (partition);
+
+                if (computed.load() > partition)
+                {
+                    audioPartition.store (-1);
+                    return outputSource = Source::primary;
+                }
+
+                compute (partition, audioScratch, true);
+                audioPartition.store (-1);
+                ++numOnAudioThread;
+                return outputSource = Source::spare;
+            }
+
+            ++numUnderruns;
+            return outputSource;
+        }
+
+        //==============================================================================
+        // Audio thread, as each partition of input fills. A new response takes
+        // over here, and this partition fades from the old one's output to the
+        // new one's.
+        void post (juce::int64 partition) noexcept
+        {
+            const TailResponse* fadingFrom = nullptr;
+
+            if (auto* incoming = pending.exchange (nullptr))
+            {
+                if (active != nullptr)
+                    active->lastPartition.store (partition);
+
+                fadingFrom = active;
+                active = incoming;
+            }
+
+            auto& r = responses[(size_t) (partition % ringSize)];
+            r.current.store (active);
+            r.fadingFrom.store (fadingFrom);
+
+            posted.store (partition + 1, std::memory_order_release);
+        }
+
+        // Either thread. With toSpare, the result goes to the spare output and
+        // the history is left alone, as the tail thread may be writing it.
+        void compute (juce::int64 partition, Scratch& scratch, bool toSpare) noexcept
+        {
+            auto& r = responses[(size_t) (partition % ringSize)];
+            auto* current = r.current.load();
+            auto* fadingFrom = r.fadingFrom.load();
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* spectrum = transformInput (partition, ch, scratch, ! toSpare);
+                auto* out = toSpare ? getSpare (ch) : getOutput (partition, ch);
+
+                if (! accumulate (current, partition, ch, spectrum, scratch.sum.data()))
+                    std::fill (out, out + partitionSize, 0.0f);
+                else
+                    inverse (scratch, scratch.sum.data(), out);
+
+                if (fadingFrom != nullptr)
+                {
+                    auto* faded = scratch.faded.data();
+
+                    if (! accumulate (fadingFrom, partition, ch, spectrum, scratch.previousSum.data()))
+                        std::fill (faded, faded + partitionSize, 0.0f);
+                    else
+                        inverse (scratch, scratch.previousSum.data(), faded);
+
+                    for (int i = 0; i < partitionSize; ++i)
+                    {
+                        auto fadeIn = (float) (i + 1) / (float) partitionSize;
+                        out[i] = out[i] * fadeIn + faded[i] * (1.0f - fadeIn);
+                    }
+                }
+            }
+        }
+
+        // Overlap-save: the spectrum of the previous partition of input and
+        // then this one, left in the scratch space and, if asked, the history.
+        const float* transformInput (juce::int64 partition, int channel, Scratch& scratch, bool toHistory) noexcept
+        {
+            auto* data = scratch.transform.data();
+
+            if (partition > 0)
+                std::copy (getInput (partition - 1, channel), getInput (partition - 1, channel) + partitionSize, data);
+            else
+                std::fill (data, data + partitionSize, 0.0f);
+
+            std::copy (getInput (partition, channel), getInput (partition, channel) + partitionSize, data + partitionSize);
+            fft->performRealOnlyForwardTransform (data, true);
+            std::copy (data, data + numBins * 2, scratch.spectrum.data());
+
+            if (toHistory)
+                std::copy (data, data + numBins * 2, getHistory ((int) (partition % fdlSize), channel));
+
+            return scratch.spectrum.data();
+        }
+
+        void transformInput (juce::int64 partition, Scratch& scratch, bool toHistory) noexcept
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                transformInput (partition, ch, scratch, toHistory);
+        }
+
+        void clearHistory (juce::int64 partition) noexcept
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                std::fill (getHistory ((int) (partition % fdlSize), ch), getHistory ((int) (partition % fdlSize), ch) + numBins * 2, 0.0f);
+        }
+
+        // The sum over the response's partitions of each one's spectrum times
+        // that of the input it lines up with, the newest of which is passed in.
+        // Returns false if the response doesn't fit this layout.
+        bool accumulate (const TailResponse* response, juce::int64 partition, int channel,
+                         const float* newest, float* dest) const noexcept
+        {
+            if (response == nullptr || response->partitionSize != partitionSize || response->numPartitions == 0)
+                return false;
+
+            std::fill (dest, dest + numBins * 2, 0.0f);
+            auto responseChannel = juce::jmin (channel, response->numChannels - 1);
+            auto numToSum = (int) juce::jmin ((juce::int64) juce::jmin (response->numPartitions, fdlSize), partition + 1);
+
+            for (int j = 0; j < numToSum; ++j)
+            {
+                auto* x = j == 0 ? newest : getHistory ((int) ((partition - j) % fdlSize), channel);
+                auto* h = response->getSpectrum (j, responseChannel);
+
+                for (int b = 0; b < numBins * 2; b += 2)
+                {
+                    dest[b]     += x[b] * h[b]     - x[b + 1] * h[b + 1];
+                    dest[b + 1] += x[b] * h[b + 1] + x[b + 1] * h[b];
+                }
+            }
+
+            return true;
+        }
+
+        // Back to the time domain, keeping the half that overlap-save leaves
+        // free of wrap-around.
+        void inverse (Scratch& scratch, const float* spectrum, float* dest) noexcept
+        {
+            auto* data = scratch.transform.data();
+            auto fftSize = partitionSize * 2;
+
+            std::copy (spectrum, spectrum + numBins * 2, data);
+
+            for (int b = 1; b < partitionSize; ++b)
+            {
+                data[(fftSize - b) * 2]     =  data[b * 2];
+                data[(fftSize - b) * 2 + 1] = -data[b * 2 + 1];
+            }
+
+            fft->performRealOnlyInverseTransform (data);
+            std::copy (data + partitionSize, data + fftSize, dest);
+        }
+
+        float* getInput (juce::int64 partition, int channel) noexcept
+        {
+            return inputs.data() + ((size_t) (partition % ringSize) * (size_t) numChannels + (size_t) channel) * (size_t) partitionSize;
+        }
+
+        float* getOutput (juce::int64 partition, int channel) noexcept
+        {
+            return outputs.data() + ((size_t) (partition % ringSize) * (size_t) numChannels + (size_t) channel) * (size_t) partitionSize;
+        }
+
+        float* getSpare (int channel) noexcept
+        {
+            return spare.data() + (size_t) channel * (size_t) partitionSize;
+        }
+
+        float* getHistory (int slot, int channel) noexcept
+        {
+            return history.data() + ((size_t) slot * (size_t) numChannels + (size_t) channel) * (size_t) numBins * 2;
+        }
+
+        const float* getHistory (int slot, int channel) const noexcept
+        {
+            return history.data() + ((size_t) slot * (size_t) numChannels + (size_t) channel) * (size_t) numBins * 2;
+        }
+
+        //==============================================================================
+        int partitionSize = minTailPartitionSize, numChannels = 0, numBins = 0, fdlSize = 1;
+        std::unique_ptr<juce::dsp::FFT> fft;
+
+        std::vector<float> inputs, outputs;     // ringSize partitions of each
+        std::vector<float> spare;               // the audio thread's copy of a partition the tail thread is late with
+        std::vector<float> history;             // the spectra of the last fdlSize input partitions
+        Scratch tailScratch, audioScratch;
+
+        // The responses each partition in the ring was posted with.
+        struct Responses
+        {
+            std::atomic<const TailResponse*> current { nullptr }, fadingFrom { nullptr };
+        };
+
+        std::array<Responses, ringSize> responses;
+        const TailResponse* active = nullptr;   // audio thread only
+
+        juce::int64 position = 0;               // input samples taken since the reset
+        std::atomic<juce::int64> posted { 0 }, computed { 0 }, claimed { 0 };
+        std::atomic<juce::int64> due { 0 };                 // the partition whose output the audio thread is on
+        std::atomic<juce::int64> audioPartition { -1 };     // the partition the audio thread is copying, if any
+        std::atomic<juce::int64> numOnAudioThread { 0 }, numUnderruns { 0 }, ticksSpent { 0 };
+
+        // Audio thread only.
+        juce::int64 outputPartition = -1;
+        Source outputSource = Source::none;
+
+        std::atomic<const TailResponse*> pending { nullptr };
+    };
+
+    //==============================================================================
+    void run() override
+    {
+        SYNTH_TRACE_THREAD ("Reverb tail");
+
+        while (! threadShouldExit())
+        {
+            // Polled rather than signalled, so that the audio thread never has
+            // to take a lock to wake it.
+            if (! tailThreadEnabled.load() || ! tail.computeNext())
+                wait (1);
+        }
+    }
+
+    static int getNumPartitions (double sampleRate, int partitionSize)
+    {
+        return (int) std::ceil (maxImpulseResponseSeconds * sampleRate / partitionSize);
+    }
+
+    // Loader thread.
+    void setSource (juce::AudioBuffer<float>&& buffer, double bufferSampleRate)
+    {
+        const juce::ScopedLock sl (sourceLock);
+        source = std::move (buffer);
+        sourceSampleRate = bufferSampleRate;
+    }
+
+    // Loader thread. Turns the source into a head for Convolution and a tail
+    // for the tail thread, at the rate and partition size last prepared for.
+    void rebuild()
+    {
+        juce::AudioBuffer<float> ir;
+        double rate, fileRate;
+        int partitionSize;
+
+        {
+            const juce::ScopedLock sl (sourceLock);
+
+            if (source.getNumSamples() == 0 || targetSampleRate <= 0.0)
+                return;
+
+            ir = source;
+            rate = targetSampleRate;
+            fileRate = sourceSampleRate;
+            partitionSize = tailPartitionSize;
+        }
+
+        ir = resampleToStereo (ir, fileRate, rate);
+        trimAndNormalise (ir);
+
+        // The tail goes first, so that once hasImpulseResponse() sees the
+        // head the tail is already on its way.
+        auto headLength = juce::jmin (ir.getNumSamples(), partitionSize * 2);
+        publishTail (createTail (ir, headLength, partitionSize));
+
+        juce::AudioBuffer<float> head (2, headLength);
+
+        for (int ch = 0; ch < 2; ++ch)
+            head.copyFrom (ch, 0, ir, ch, 0, headLength);
+
+        convolution.loadImpulseResponse (std::move (head), rate,
+                                         juce::dsp::Convolution::Stereo::yes,
+                                         juce::dsp::Convolution::Trim::no,
+                                         juce::dsp::Convolution::Normalise::no);
+    }
+
+    static juce::AudioBuffer<float> resampleToStereo (const juce::AudioBuffer<float>& ir, double fromRate, double toRate)
+    {
+        auto ratio = fromRate / toRate;
+        auto length = juce::jmax (1, (int) std::ceil (ir.getNumSamples() / ratio));
+        juce::AudioBuffer<float> result (2, length);
+
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            auto* src = ir.getReadPointer (juce::jmin (ch, ir.getNumChannels() - 1));
+
+            if (fromRate == toRate)
+            {
+                result.copyFrom (ch, 0, src, length);
+                continue;
+            }
+
+            // The interpolator reads a few samples past the end, so give it
+            // some silence there.
+            std::vector<float> padded ((size_t) ir.getNumSamples() + 8, 0.0f);
+            std::copy (src, src + ir.getNumSamples(), padded.begin());
+
+            juce::LagrangeInterpolator interpolator;
+            interpolator.process (ratio, padded.data(), result.getWritePointer (ch), length);
+        }
+
+        return result;
+    }
+
+    // Drops silence from either end, then scales for unit energy in the
+    // louder channel.
+    static void trimAndNormalise (juce::AudioBuffer<float>& ir)
+    {
+        auto peak = ir.getMagnitude (0, ir.getNumSamples());
+
+        if (peak <= 0.0f)
+            return;
+
+        auto threshold = peak * 1.0e-4f;
+        int first = ir.getNumSamples(), last = 0;
+
+        for (int ch = 0; ch < ir.getNumChannels(); ++ch)
+        {
+            auto* d = ir.getReadPointer (ch);
+
+            for (int i = 0; i < ir.getNumSamples(); ++i)
+            {
+                if (std::abs (d[i]) > threshold)
+                {
+                    first = juce::jmin (first, i);
+                    last = juce::jmax (last, i);
+                }
+            }
+        }
+
+        juce::AudioBuffer<float> trimmed (ir.getNumChannels(), last - first + 1);
+        auto maxEnergy = 0.0;
+
+        for (int ch = 0; ch < ir.getNumChannels(); ++ch)
+        {
+            trimmed.copyFrom (ch, 0, ir, ch, first, trimmed.getNumSamples());
+
+            auto energy = 0.0;
+            auto* d = trimmed.getReadPointer (ch);
+
+            for (int i = 0; i < trimmed.getNumSamples(); ++i)
+                energy += (double) d[i] * (double) d[i];
+
+            maxEnergy = juce::jmax (maxEnergy, energy);
+        }
+
+        trimmed.applyGain ((float) (1.0 / std::sqrt (maxEnergy)));
+        ir = std::move (trimmed);
+    }
+
+    std::unique_ptr<TailResponse> createTail (const juce::AudioBuffer<float>& ir, int headLength, int partitionSize)
+    {
+        auto response = std::make_unique<TailResponse>();
+        auto tailLength = ir.getNumSamples() - headLength;
+
+        response->partitionSize = partitionSize;
+        response->numChannels = ir.getNumChannels();
+        response->numPartitions = juce::jmax (0, (tailLength + partitionSize - 1) / partitionSize);
+        response->spectra.assign ((size_t) response->numPartitions * (size_t) response->numChannels
+                                    * (size_t) (partitionSize + 1) * 2, 0.0f);
+
+        juce::dsp::FFT fft (juce::roundToInt (std::log2 (partitionSize * 2)));
+        std::vector<float> data ((size_t) partitionSize * 4);
+
+        for (int p = 0; p < response->numPartitions; ++p)
+        {
+            auto start = headLength + p * partitionSize;
+            auto num = juce::jmin (partitionSize, ir.getNumSamples() - start);
+
+            for (int ch = 0; ch < response->numChannels; ++ch)
+            {
+                std::fill (data.begin(), data.end(), 0.0f);
+                std::copy (ir.getReadPointer (ch, start), ir.getReadPointer (ch, start) + num, data.begin());
+                fft.performRealOnlyForwardTransform (data.data(), true);
+
+                std::copy (data.begin(), data.begin() + (partitionSize + 1) * 2, response->getSpectrum (p, ch));
+            }
+        }
+
+        return response;
+    }
+
+    // Loader thread. Hands the tail over with a pointer swap, and frees any
+    // that the tail convolver has moved past: those it never picked up, and
+    // those replaced before a partition that both threads are done with.
+    void publishTail (std::unique_ptr<TailResponse> response)
+    {
+        auto* superseded = tail.pending.exchange (response.get());
+
+        // Read in the opposite order to the audio thread's writes, so that a
+        // copy it has started is always seen.
+        auto numComputed = tail.computed.load();
+        auto copying = tail.audioPartition.load();
+
+        tailsInFlight.erase (std::remove_if (tailsInFlight.begin(), tailsInFlight.end(),
+                                             [=] (const std::unique_ptr<TailResponse>& t)
+                                             {
+                                                 auto last = t->lastPartition.load();
+                                                 return t.get() == superseded
+                                                         || (last < numComputed && (copying < 0 || copying > last));
+                                             }),
+                             tailsInFlight.end());
+
+        tailsInFlight.push_back (std::move (response));
+    }
+
+    //==============================================================================
+    juce::dsp::Convolution convolution;
+    juce::dsp::DryWetMixer<float> dryWet;
+    TailConvolver tail;
+
+    std::atomic<bool> enabled { false }, tailThreadEnabled { true };
+    std::atomic<float> wetLevel { 0.3f };
+    bool prepared = false;
+
+    // The response as loaded, before resampling, kept for when the rate changes.
+    juce::CriticalSection sourceLock;
+    juce::AudioBuffer<float> source;
+    double sourceSampleRate = 0.0, targetSampleRate = 0.0;
+    int tailPartitionSize = minTailPartitionSize;
+
+    // Owned by the loader thread.
+    std::vector<std::unique_ptr<TailResponse>> tailsInFlight;
+
+    // Last, so that it's gone before anything its jobs use.
+    juce::ThreadPool loader { 1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MasterReverb)
+};
@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    Keeps a cached list of the MIDI input devices, rescanned on a background
+    thread. Enumerating devices can take a while on systems with many ALSA
+    sequencer clients, so the message thread only ever reads the cache and
+    hears about changes through onChange.
+
+    JUCE has no hot-plug notification on every platform, so the thread polls.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+class MidiDeviceWatcher   : private juce::Thread,
+                            private juce::AsyncUpdater
+{
+public:
+    explicit MidiDeviceWatcher (int pollIntervalMs = 2000)
+        : juce::Thread ("MIDI device watcher"), interval (pollIntervalMs)
+    {
+    }
+
+    ~MidiDeviceWatcher() override
+    {
+        stopThread (4000);
+        cancelPendingUpdate();
+    }
+
+    // Called on the message thread after the first scan and whenever the list
+    // changes after that.
+    std::function<void()> onChange;
+
+    void start()
+    {
+        if (! isThreadRunning())
+            startThread (2);
+    }
+
+    // Asks for a scan now rather than at the next poll.
+    void rescan()    { notify(); }
+
+    juce::Array<juce::MidiDeviceInfo> getDevices() const
+    {
+        const juce::ScopedLock sl (lock);
+        return devices;
+    }
+
+    bool hasScanned() const noexcept            { return numScans.load() > 0; }
+    double getLastScanMilliseconds() const      { return lastScanMs.load(); }
+
+private:
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            auto started = juce::Time::getMillisecondCounterHiRes();
+            auto found = juce::MidiInput::getAvailableDevices();
+            lastScanMs = juce::Time::getMillisecondCounterHiRes() - started;
+
+            bool changed;
+
+            {
+                const juce::ScopedLock sl (lock);
+                changed = found != devices;
+
+                if (changed)
+                    devices.swapWith (found);
+            }
+
+            if (++numScans == 1 || changed)
+                triggerAsyncUpdate();
+
+            wait (interval);
+        }
+    }
+
+    void handleAsyncUpdate() override
+    {
+        if (onChange != nullptr)
+            onChange();
+    }
+
+    //==============================================================================
+    const int interval;
+
+    juce::CriticalSection lock;
+    juce::Array<juce::MidiDeviceInfo> devices;
+
+    std::atomic<int> numScans { 0 };
+    std::atomic<double> lastScanMs { 0.0 };
+
+    JUCE_DECLARE_NON_COPYABLE (MidiDeviceWatcher)
+};
@@ -0,0 +1,272 @@
+/*
+  ==============================================================================
+
+    Takes the place of juce::MidiMessageCollector when several MIDI inputs
+    are open at once.
+
+    Each open device gets a port, whose callback pushes short messages into
+    the port's own lock-free FIFO on the device's thread. Once per block the
+    audio thread merges the FIFOs by timestamp, so events from different
+    devices interleave in the order they arrived. It then places them in
+    the block the way MidiMessageCollector does. Ports are allocated up
+    front and reused, so opening and closing devices never touches memory
+    the audio thread can see.
+
+    Only messages of three bytes or fewer are passed on; the synth has no
+    use for sysex.
+
+    Each event also keeps the tick count at which its callback ran, so that a
+    LatencyProbe can time note-ons through to the audio they make.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "LatencyProbe.h"
+
+//==============================================================================
+class MidiInputMerger
+{
+public:
+    static constexpr int maxPorts = 16;
+    static constexpr int queueSize = 1024;
+
+    // The most that removeNextBlockOfMessages() can add in one block, in
+    // MidiBuffer bytes: every port's FIFO full of three-byte messages, each
+    // stored with its timestamp and size.
+    static constexpr size_t maxBlockBytes = (size_t) maxPorts * queueSize * (sizeof (juce::int32) + sizeof (juce::uint16) + 3);
+
+    struct PortStats
+    {
+        juce::String identifier;
+        juce::uint64 numEvents = 0, numDropped = 0;
+        double eventsPerSecond = 0.0;
+        double meanLatencyMs = 0.0, maxLatencyMs = 0.0;   // from the device's timestamp to the block that took it
+    };
+
+    //==============================================================================
+    MidiInputMerger() = default;
+
+    void reset (double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+    }
+
+    // Returns the callback to register with the device manager for this
+    // device, or nullptr if every port is taken. Message thread only.
+    juce::MidiInputCallback* openPort (const juce::String& identifier)
+    {
+        auto* port = findPort (identifier);
+
+        if (port == nullptr)
+            for (auto& p : ports)
+                if (! p.open && p.identifier.isEmpty())
+                    port = &p;
+
+        if (port == nullptr)
+            for (auto& p : ports)
+                if (! p.open)
+                    port = &p;
+
+        if (port == nullptr)
+            return nullptr;
+
+        if (port->identifier != identifier)
+        {
+            port->identifier = identifier;
+            port->numEvents = port->numDropped = port->numLatencies = 0;
+            port->totalLatency = port->maxLatency = 0.0;
+            port->lastCount = 0;
+        }
+
+        port->lastCountTime = juce::Time::getMillisecondCounterHiRes();
+        port->open = true;
+        return port;
+    }
+
+    juce::MidiInputCallback* getPort (const juce::String& identifier)
+    {
+        auto* port = findPort (identifier);
+        return port != nullptr && port->open ? port : nullptr;
+    }
+
+    // The device's callback must have been removed before this is called, so
+    // that nothing is still pushing into the port.
+    void closePort (const juce::String& identifier)
+    {
+        if (auto* port = findPort (identifier))
+            port->open = false;
+    }
+
+    // Counters for every port that's open. Message thread only.
+    juce::Array<PortStats> getStats()
+    {
+        juce::Array<PortStats> result;
+        auto now = juce::Time::getMillisecondCounterHiRes();
+
+        for (auto& port : ports)
+        {
+            if (! port.open)
+                continue;
+
+            PortStats stats;
+            stats.identifier = port.identifier;
+            stats.numEvents = port.numEvents;
+            stats.numDropped = port.numDropped;
+
+            auto elapsed = (now - port.lastCountTime) * 0.001;
+
+            if (elapsed > 0.0)
+                stats.eventsPerSecond = (double) (stats.numEvents - port.lastCount) / elapsed;
+
+            port.lastCount = stats.numEvents;
+            port.lastCountTime = now;
+
+            auto numLatencies = port.numLatencies.load();
+            stats.meanLatencyMs = numLatencies > 0 ? port.totalLatency.load() * 1000.0 / (double) numLatencies : 0.0;
+            stats.maxLatencyMs = port.maxLatency.load() * 1000.0;
+            result.add (stats);
+        }
+
+        return result;
+    }
+
+    //==============================================================================
+    // Takes everything that arrived since the last block, in timestamp order,
+    // with positions spread over the last numSamples worth of time. Audio
+    // thread only; dest should have had space reserved.
+    void removeNextBlockOfMessages (juce::MidiBuffer& dest, int numSamples, LatencyProbe* probe = nullptr)
+    {
+        auto now = juce::Time::getMillisecondCounterHiRes() * 0.001;
+        auto blockStart = now - numSamples / sampleRate;
+
+        Cursor cursors[maxPorts];
+
+        for (int p = 0; p < maxPorts; ++p)
+            cursors[p].begin (ports[(size_t) p]);
+
+        for (;;)
+        {
+            int next = -1;
+
+            for (int p = 0; p < maxPorts; ++p)
+                if (cursors[p].hasEvent() && (next < 0 || cursors[p].peek().time < cursors[next].peek().time))
+                    next = p;
+
+            if (next < 0)
+                break;
+
+            auto& event = cursors[next].peek();
+            auto position = juce::jlimit (0, juce::jmax (0, numSamples - 1), (int) ((event.time - blockStart) * sampleRate));
+
+            dest.addEvent (event.data, event.size, position);
+
+            if (probe != nullptr && event.size == 3 && (event.data[0] & 0xf0) == 0x90 && event.data[2] != 0)
+                probe->noteOnTaken (event.arrivalTicks, position);
+
+            cursors[next].advance (now - event.time);
+        }
+
+        for (auto& cursor : cursors)
+            cursor.finish();
+    }
+
+private:
+    //==============================================================================
+    struct Event
+    {
+        double time;
+        juce::int64 arrivalTicks;
+        juce::uint8 data[3];
+        juce::uint8 size;
+    };
+
+    struct Port   : public juce::MidiInputCallback
+    {
+        void handleIncomingMidiMessage (juce::MidiInput*, const juce::MidiMessage& message) override
+        {
+            auto size = message.getRawDataSize();
+
+            if (size > 3)
+                return;
+
+            ++numEvents;
+            const juce::AbstractFifo::ScopedWrite write (fifo, 1);
+
+            if (write.blockSize1 + write.blockSize2 == 0)
+            {
+                ++numDropped;
+                return;
+            }
+
+            auto& event = events[(size_t) (write.blockSize1 > 0 ? write.startIndex1 : write.startIndex2)];
+            event.time = message.getTimeStamp();
+            event.arrivalTicks = juce::Time::getHighResolutionTicks();
+            event.size = (juce::uint8) size;
+            std::memcpy (event.data, message.getRawData(), (size_t) size);
+        }
+
+        juce::AbstractFifo fifo { queueSize };
+        std::array<Event, queueSize> events;
+
+        std::atomic<bool> open { false };
+        std::atomic<juce::uint64> numEvents { 0 }, numDropped { 0 }, numLatencies { 0 };
+        std::atomic<double> totalLatency { 0.0 }, maxLatency { 0.0 };   // seconds; written by the audio thread
+
+        // Message thread only.
+        juce::String identifier;
+        juce::uint64 lastCount = 0;
+        double lastCountTime = 0.0;
+    };
+
+    // Walks the events that a port had ready when the block started, without
+    // copying them out of its FIFO.
+    struct Cursor
+    {
+        void begin (Port& p)
+        {
+            port = &p;
+            p.fifo.prepareToRead (p.fifo.getNumReady(), start1, size1, start2, size2);
+            index = 0;
+        }
+
+        bool hasEvent() const noexcept     { return index < size1 + size2; }
+
+        const Event& peek() const noexcept
+        {
+            return port->events[(size_t) (index < size1 ? start1 + index : start2 + index - size1)];
+        }
+
+        void advance (double latency) noexcept
+        {
+            ++index;
+            ++port->numLatencies;
+            port->totalLatency = port->totalLatency.load() + latency;
+            port->maxLatency = juce::jmax (port->maxLatency.load(), latency);
+        }
+
+        void finish() noexcept
+        {
+            port->fifo.finishedRead (index);
+        }
+
+        Port* port = nullptr;
+        int start1 = 0, size1 = 0, start2 = 0, size2 = 0, index = 0;
+    };
+
+    Port* findPort (const juce::String& identifier)
+    {
+        for (auto& port : ports)
+            if (port.identifier == identifier)
+                return &port;
+
+        return nullptr;
+    }
+
+    //==============================================================================
+    std::array<Port, maxPorts> ports;
+    double sampleRate = 44100.0;
+
+    JUCE_DECLARE_NON_COPYABLE (MidiInputMerger)
+};
@@ -0,0 +1,232 @@
+/*
+  ==============================================================================
+
+    Velocity and keyboard-tracking curves, applied to a note's level when it
+    starts.
+
+    Each curve is a 128-entry table, indexed by MIDI velocity or by note
+    number, so a note-on costs two loads and a multiply. The built-in
+    velocity curves and flat key tracking are constexpr tables; the power
+    curve, whose exponent is a setting, and key tracking curves are worked
+    out on the message thread. Key tracking never adds more than 12 dB, so a
+    steep slope can't make the top notes clip.
+
+    NoteResponse hands the audio thread a new pair of tables with a single
+    pointer swap, which it picks up at the start of its next block. The
+    message thread keeps every pair alive until the audio thread has moved
+    past it. A preset recall carries its own pair, which is applied in the
+    same swap as the rest of the preset; whichever pair was made last wins.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+struct CurveTable
+{
+    float values[128];
+
+    float operator[] (int index) const noexcept    { return values[index]; }
+};
+
+//==============================================================================
+namespace NoteCurves
+{
+    enum class Velocity
+    {
+        linear,     // the level follows the velocity
+        soft,       // quiet until played hard: velocity squared
+        hard,       // loud from lower velocities: 1 - (1 - velocity) squared
+        fixed,      // full level at any velocity
+        power       // velocity to a chosen exponent, made by makePowerCurve()
+    };
+
+    constexpr int numBuiltInVelocityCurves = 4, numVelocityCurves = 5;
+    constexpr float minVelocityExponent = 0.25f, maxVelocityExponent = 4.0f;
+
+    // The most key tracking can raise a note by, +12 dB, which also bounds a
+    // note's gain as every velocity curve tops out at 1.
+    constexpr float maxKeyGain = 3.981072f;
+
+    constexpr CurveTable makeVelocityCurve (Velocity shape)
+    {
+        CurveTable table {};
+
+        for (int i = 0; i < 128; ++i)
+        {
+            // The same float that juce::MidiMessage::getFloatVelocity() gives,
+            // so that the linear curve leaves the level exactly as it was.
+            auto v = (float) i * (1.0f / 127.0f);
+
+            switch (shape)
+            {
+                case Velocity::linear:  table.values[i] = v; break;
+                case Velocity::soft:    table.values[i] = v * v; break;
+                case Velocity::hard:    table.values[i] = v * (2.0f - v); break;
+                case Velocity::fixed:   table.values[i] = i > 0 ? 1.0f : 0.0f; break;
+                case Velocity::power:   table.values[i] = v; break;   // at the default exponent of 1
+            }
+        }
+
+        return table;
+    }
+
+    constexpr CurveTable makeFlatKeys()
+    {
+        CurveTable table {};
+
+        for (auto& value : table.values)
+            value = 1.0f;
+
+        return table;
+    }
+
+    constexpr CurveTable velocityCurves[numBuiltInVelocityCurves] = { makeVelocityCurve (Velocity::linear),
+                                                               makeVelocityCurve (Velocity::soft),
+                                                               makeVelocityCurve (Velocity::hard),
+                                                               makeVelocityCurve (Velocity::fixed) };
+
+    constexpr CurveTable flatKeys = makeFlatKeys();
+
+    //==============================================================================
+    // Velocity to the power of exponent: above 1 it's softer than linear, below
+    // 1 harder. The exponent is clamped to the range a preset can hold.
+    inline CurveTable makePowerCurve (float exponent)
+    {
+        CurveTable table {};
+        exponent = juce::jlimit (minVelocityExponent, maxVelocityExponent, exponent);
+
+        for (int i = 0; i < 128; ++i)
+            table.values[i] = std::pow ((float) i * (1.0f / 127.0f), exponent);
+
+        return table;
+    }
+
+    // Changes the level by dbPerOctave for each octave above centreNote, and
+    // the other way below it, up to maxKeyGain.
+    inline CurveTable makeKeyTracking (double dbPerOctave, int centreNote = 60)
+    {
+        CurveTable table {};
+
+        for (int i = 0; i < 128; ++i)
+            table.values[i] = juce::jmin (maxKeyGain, juce::Decibels::decibelsToGain ((float) (dbPerOctave * (i - centreNote) / 12.0), -200.0f));
+
+        return table;
+    }
+}
+
+//==============================================================================
+class NoteResponse
+{
+public:
+    // What a preset stores; the tables are made from it.
+    struct Settings
+    {
+        int velocityCurve = 0;                  // a NoteCurves::Velocity
+        float velocityExponent = 1.0f;          // for the power curve
+        float keyTrackingDbPerOctave = 0.0f;
+        int keyCentre = 60;
+    };
+
+    struct Tables
+    {
+        CurveTable velocity, keys;
+        juce::uint64 generation;
+    };
+
+    NoteResponse() = default;
+
+    // Message thread. The new curves reach notes that start from the audio
+    // thread's next block on; sounding notes keep their level.
+    void setSettings (const Settings& newSettings)     { publish (prepare (newSettings)); }
+
+    // The settings last given, on the message thread.
+    const Settings& getSettings() const noexcept       { return settings; }
+
+    // Message thread. Makes the tables for some settings, for a preset recall
+    // to hand to apply() along with everything else it sets.
+    Tables prepare (const Settings& newSettings)
+    {
+        settings = newSettings;
+        auto curve = juce::jlimit (0, NoteCurves::numVelocityCurves - 1, settings.velocityCurve);
+
+        return { curve < NoteCurves::numBuiltInVelocityCurves ? NoteCurves::velocityCurves[curve]
+                                                              : NoteCurves::makePowerCurve (settings.velocityExponent),
+                 NoteCurves::makeKeyTracking (settings.keyTrackingDbPerOctave, settings.keyCentre),
+                 ++generation };
+    }
+
+    // Audio thread, at the start of each block.
+    void applyPending() noexcept
+    {
+        if (auto* tables = pending.exchange (nullptr))
+        {
+            if (tables->generation > appliedGeneration.load())
+            {
+                active = tables;
+                appliedGeneration = tables->generation;
+            }
+        }
+    }
+
+    // Audio thread. Copies in a pair made by prepare(), unless a newer one has
+    // already been applied.
+    void apply (const Tables& tables) noexcept
+    {
+        if (tables.generation > appliedGeneration.load())
+        {
+            recalled = tables;
+            active = &recalled;
+            appliedGeneration = tables.generation;
+        }
+    }
+
+    // Audio thread, at note-on. Never more than NoteCurves::maxKeyGain.
+    float getGain (int midiNoteNumber, float noteVelocity) const noexcept
+    {
+        auto index = juce::jlimit (0, 127, (int) (noteVelocity * 127.0f + 0.5f));
+        return juce::jmin (NoteCurves::maxKeyGain, active->velocity[index] * active->keys[midiNoteNumber & 127]);
+    }
+
+    // For voices that may not have been given a NoteResponse: without one the
+    // velocity is used as it is.
+    static float getGain (const NoteResponse* response, int midiNoteNumber, float noteVelocity) noexcept
+    {
+        return response != nullptr ? response->getGain (midiNoteNumber, noteVelocity) : noteVelocity;
+    }
+
+private:
+    void publish (const Tables& newTables)
+    {
+        auto tables = std::make_unique<Tables> (newTables);
+        auto* superseded = pending.exchange (tables.get());
+
+        // The audio thread has finished with anything older than what it last
+        // applied, and never saw a pending pair that was swapped out from
+        // under it. A pair it skipped for being older is never used either.
+        auto applied = appliedGeneration.load();
+
+        inFlight.erase (std::remove_if (inFlight.begin(), inFlight.end(),
+                                        [=] (const std::unique_ptr<Tables>& t)
+                                        {
+                                            return t.get() == superseded || t->generation < applied;
+                                        }),
+                        inFlight.end());
+
+        inFlight.push_back (std::move (tables));
+    }
+
+    //==============================================================================
+    Settings settings;
+    juce::uint64 generation = 0;
+    std::vector<std::unique_ptr<Tables>> inFlight;
+
+    const Tables defaults { NoteCurves::velocityCurves[0], NoteCurves::flatKeys, 0 };
+    Tables recalled = defaults;   // the audio thread's copy of a preset's pair
+    const Tables* active = &defaults;
+    std::atomic<Tables*> pending { nullptr };
+    std::atomic<juce::uint64> appliedGeneration { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (NoteResponse)
+};
@@ -0,0 +1,456 @@
+/*
+  ==============================================================================
+
+    Offline, deterministic rendering of fixed MIDI scenarios through
+    SynthAudioSource, plus golden-reference comparison.
+
+    --golden-render=<dir> writes a manifest of each scenario's size and a
+    hash of its samples, plus WAVs to listen to; the manifest in
+    Tests/golden is the one that's committed. --golden-verify=<dir> checks
+    the reference kernels bit-exactly against the manifest, then every other
+    kernel level against that reference render. Every scenario is rendered
+    at a fixed sample rate and block size, so the output only changes when
+    the voice engine does.
+
+    The reference kernels call std::sin, whose last bit can differ between
+    C libraries, so the manifest belongs to the platform that wrote it.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <iostream>
+#include <map>
+
+//==============================================================================
+struct RenderSettings
+{
+    double sampleRate = 48000.0;
+    int blockSize = 256;
+    int numChannels = 2;
+};
+
+struct RenderScenario
+{
+    juce::String name;
+    double lengthSeconds = 1.0;
+    double decay = 0.999;
+    juce::MidiMessageSequence events;   // timestamps are in seconds
+    int sound = EnginePreset::sineSound;
+};
+
+// How closely a render has to match its reference. The reference path must
+// be bit-exact; approximation kernels only have to stay above an SNR floor.
+struct RenderTolerance
+{
+    bool bitExact = true;
+    double minSnrDb = 0.0;
+};
+
+//==============================================================================
+namespace OfflineRenderer
+{
+    inline void addNote (RenderScenario& scenario, int note, float velocity, double onTime, double offTime)
+    {
+        scenario.events.addEvent (juce::MidiMessage::noteOn  (1, note, velocity).withTimeStamp (onTime));
+        scenario.events.addEvent (juce::MidiMessage::noteOff (1, note).withTimeStamp (offTime));
+    }
+
+    inline juce::Array<RenderScenario> createScenarios()
+    {
+        juce::Array<RenderScenario> scenarios;
+
+        {
+            RenderScenario s { "single_note", 1.0, 0.999, {} };
+            addNote (s, 69, 0.8f, 0.0, 0.5);
+            scenarios.add (s);
+        }
+
+        {
+            RenderScenario s { "chord_long_tail", 2.0, 0.99999, {} };
+            addNote (s, 60, 0.7f, 0.0,  0.6);
+            addNote (s, 64, 0.6f, 0.01, 0.6);
+            addNote (s, 67, 0.5f, 0.02, 0.6);
+            scenarios.add (s);
+        }
+
+        {
+            // More notes than voices, so stealing is exercised.
+            RenderScenario s { "voice_stealing", 1.5, 0.9995, {} };
+            for (int i = 0; i < 8; ++i)
+                addNote (s, 48 + i * 3, 0.4f + 0.05f * (float) i, 0.05 * i, 0.8 + 0.05 * i);
+            scenarios.add (s);
+        }
+
+        {
+            // Note-ons that land mid-block and repeat before the tail has finished.
+            RenderScenario s { "fast_repeats", 1.0, 0.9999, {} };
+            for (int i = 0; i < 16; ++i)
+                addNote (s, 72 + (i % 3), 1.0f, 0.0371 * i, 0.0371 * i + 0.02);
+            scenarios.add (s);
+        }
+
+        {
+            // FM notes starting mid-block after silence, when no FM lane has
+            // rendered anything yet that block.
+            RenderScenario s { "fm_into_silence", 1.5, 0.999, {}, EnginePreset::fmSound };
+            addNote (s, 60, 0.8f, 0.0123, 0.4);
+            addNote (s, 67, 0.6f, 0.7041, 1.0);
+            scenarios.add (s);
+        }
+
+        for (auto& s : scenarios)
+            s.events.updateMatchedPairs();
+
+        return scenarios;
+    }
+
+    // Loads every track of a standard MIDI file into one scenario, leaving a
+    // couple of seconds at the end for tails.
+    inline bool loadMidiFile (const juce::File& file, RenderScenario& scenario)
+    {
+        juce::FileInputStream stream (file);
+        juce::MidiFile midiFile;
+
+        if (! stream.openedOk() || ! midiFile.readFrom (stream))
+            return false;
+
+        midiFile.convertTimestampTicksToSeconds();
+
+        scenario.name = file.getFileNameWithoutExtension();
+        scenario.events.clear();
+
+        for (int i = 0; i < midiFile.getNumTracks(); ++i)
+            scenario.events.addSequence (*midiFile.getTrack (i), 0.0);
+
+        scenario.events.updateMatchedPairs();
+        scenario.lengthSeconds = midiFile.getLastTimestamp() + 2.0;
+        return true;
+    }
+
+    //==============================================================================
+    // Calls renderBlock (buffer, midi, startSample, numSamples) for each block of
+    // the scenario, with the scenario's events placed at absolute sample positions.
+    template <typename BlockRenderer>
+    juce::AudioBuffer<float> renderBlocks (const RenderScenario& scenario, const RenderSettings& settings,
+                                           BlockRenderer&& renderBlock)
+    {
+        auto totalSamples = (int) std::ceil (scenario.lengthSeconds * settings.sampleRate);
+        juce::AudioBuffer<float> output (settings.numChannels, totalSamples);
+        output.clear();
+
+        auto eventIndex = 0;
+
+        for (auto start = 0; start < totalSamples; start += settings.blockSize)
+        {
+            auto numSamples = juce::jmin (settings.blockSize, totalSamples - start);
+            juce::MidiBuffer midi;
+
+            for (; eventIndex < scenario.events.getNumEvents(); ++eventIndex)
+            {
+                auto& message = scenario.events.getEventPointer (eventIndex)->message;
+                auto position = juce::roundToInt (message.getTimeStamp() * settings.sampleRate);
+
+                if (position >= start + numSamples)
+                    break;
+
+                midi.addEvent (message, juce::jmax (start, position));
+            }
+
+            renderBlock (output, midi, start, numSamples);
+        }
+
+        return output;
+    }
+
+    inline juce::AudioBuffer<float> render (const RenderScenario& scenario, const RenderSettings& settings)
+    {
+        SynthAudioSource source;
+        source.setDecay (scenario.decay);
+        source.getParts().setSound (0, scenario.sound);
+        source.prepareToPlay (settings.blockSize, settings.sampleRate);
+
+        auto output = renderBlocks (scenario, settings, [&] (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi,
+                                                             int start, int numSamples)
+        {
+            source.renderNextBlock (juce::AudioSourceChannelInfo (&buffer, start, numSamples), midi);
+        });
+
+        source.releaseResources();
+        return output;
+    }
+
+    // The same scenario through the devirtualised StereoSynthesiser, which only
+    // has sine voices. It has to match render() exactly for sine scenarios
+    // when the reference kernels are active.
+    inline juce::AudioBuffer<float> renderStatic (const RenderScenario& scenario, const RenderSettings& settings)
+    {
+        jassert (settings.numChannels == 2);
+
+        StereoSynthesiser<SineWaveVoice> synth (SynthAudioSource::numVoices);
+        synth.addSound (new SineWaveSound());
+        synth.setCurrentPlaybackSampleRate (settings.sampleRate);
+
+        for (int i = 0; i < synth.getNumVoices(); ++i)
+            synth.getVoice (i)->setDecay (scenario.decay);
+
+        return renderBlocks (scenario, settings, [&] (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi,
+                                                      int start, int numSamples)
+        {
+            synth.renderNextBlock (buffer, midi, start, numSamples);
+        });
+    }
+
+    //==============================================================================
+    inline bool writeWavFile (const juce::File& file, const juce::AudioBuffer<float>& buffer, double sampleRate)
+    {
+        file.deleteFile();
+        std::unique_ptr<juce::FileOutputStream> stream (file.createOutputStream());
+
+        if (stream == nullptr)
+            return false;
+
+        // 32 bits makes the WAV writer store IEEE floats, so a round trip is lossless.
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), sampleRate,
+                                                                              (unsigned int) buffer.getNumChannels(),
+                                                                              32, {}, 0));
+        if (writer == nullptr)
+            return false;
+
+        stream.release();
+        return writer->writeFromAudioSampleBuffer (buffer, 0, buffer.getNumSamples());
+    }
+
+    //==============================================================================
+    // 64-bit FNV-1a over the samples' bit patterns, channel by channel.
+    inline juce::uint64 hashSamples (const juce::AudioBuffer<float>& buffer)
+    {
+        juce::uint64 hash = 14695981039346656037ull;
+
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        {
+            auto* bytes = reinterpret_cast<const juce::uint8*> (buffer.getReadPointer (ch));
+
+            for (size_t i = 0; i < sizeof (float) * (size_t) buffer.getNumSamples(); ++i)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    struct ManifestEntry
+    {
+        int numChannels = 0, numSamples = 0;
+        juce::uint64 hash = 0;
+    };
+
+    // One line per scenario: name, channels, samples and hash in hex. Lines
+    // starting with # are comments.
+    inline juce::String toManifestLine (const juce::String& name, const juce::AudioBuffer<float>& buffer)
+    {
+        return name + " " + juce::String (buffer.getNumChannels()) + " " + juce::String (buffer.getNumSamples())
+                 + " " + juce::String::toHexString ((juce::int64) hashSamples (buffer)).paddedLeft ('0', 16);
+    }
+
+    inline bool readManifest (const juce::File& file, std::map<juce::String, ManifestEntry>& entries)
+    {
+        if (! file.existsAsFile())
+            return false;
+
+        for (auto& line : juce::StringArray::fromLines (file.loadFileAsString()))
+        {
+            auto tokens = juce::StringArray::fromTokens (line.trim(), " ", {});
+
+            if (tokens.size() != 4 || tokens[0].startsWithChar ('#'))
+                continue;
+
+            entries[tokens[0]] = { tokens[1].getIntValue(), tokens[2].getIntValue(),
+                                   (juce::uint64) tokens[3].getHexValue64() };
+        }
+
+        return true;
+    }
+
+    inline bool matchesManifest (const ManifestEntry& entry, const juce::AudioBuffer<float>& buffer, juce::String& failureReason)
+    {
+        if (entry.numChannels != buffer.getNumChannels() || entry.numSamples != buffer.getNumSamples())
+            failureReason = "size mismatch";
+        else if (entry.hash != hashSamples (buffer))
+            failureReason = "hash mismatch";
+
+        return failureReason.isEmpty();
+    }
+
+    //==============================================================================
+    inline double computeSnrDb (const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& test)
+    {
+        double signal = 0.0, noise = 0.0;
+
+        for (int ch = 0; ch < reference.getNumChannels(); ++ch)
+        {
+            auto* r = reference.getReadPointer (ch);
+            auto* t = test.getReadPointer (ch);
+
+            for (int i = 0; i < reference.getNumSamples(); ++i)
+            {
+                auto diff = (double) t[i] - (double) r[i];
+                signal += (double) r[i] * (double) r[i];
+                noise  += diff * diff;
+            }
+        }
+
+        if (noise == 0.0)
+            return std::numeric_limits<double>::infinity();
+
+        return 10.0 * std::log10 (signal / noise);
+    }
+
+    inline bool matches (const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& test,
+                         const RenderTolerance& tolerance, juce::String& failureReason)
+    {
+        if (reference.getNumChannels() != test.getNumChannels()
+             || reference.getNumSamples() != test.getNumSamples())
+        {
+            failureReason = "size mismatch";
+            return false;
+        }
+
+        if (tolerance.bitExact)
+        {
+            for (int ch = 0; ch < reference.getNumChannels(); ++ch)
+            {
+                auto* r = reference.getReadPointer (ch);
+                auto* t = test.getReadPointer (ch);
+
+                if (std::memcmp (r, t, sizeof (float) * (size_t) reference.getNumSamples()) != 0)
+                {
+                    for (int i = 0; i < reference.getNumSamples(); ++i)
+                    {
+                        if (r[i] != t[i])
+                        {
+                            failureReason = "first difference at channel " + juce::String (ch)
+                                              + ", sample " + juce::String (i);
+                            break;
+                        }
+                    }
+
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        auto snr = computeSnrDb (reference, test);
+
+        if (snr < tolerance.minSnrDb)
+        {
+            failureReason = "SNR " + juce::String (snr, 1) + " dB is below " + juce::String (tolerance.minSnrDb, 1) + " dB";
+            return false;
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    inline RenderTolerance getToleranceFor (RenderKernels::Level level)
+    {
+        if (level == RenderKernels::Level::reference)
+            return { true, 0.0 };
+
+        return { false, 100.0 };
+    }
+
+    /** Renders every scenario and either writes a new manifest (and WAVs) or
+        checks against the stored one. The manifest always comes from the
+        reference kernels; verification runs every kernel level this CPU
+        supports, comparing them with the reference render.
+        A missing manifest is a failure, so that a test run can't pass
+        without having checked anything. Returns a process exit code.
+    */
+    inline int runGolden (const juce::File& directory, bool updateReferences)
+    {
+        RenderSettings settings;
+        auto failures = 0;
+        auto previousLevel = RenderKernels::getActive().level;
+        auto manifestFile = directory.getChildFile ("manifest.txt");
+        std::map<juce::String, ManifestEntry> manifest;
+
+        if (updateReferences)
+        {
+            if (! directory.createDirectory())
+            {
+                std::cerr << "Couldn't create " << directory.getFullPathName() << std::endl;
+                return 1;
+            }
+        }
+        else if (! readManifest (manifestFile, manifest))
+        {
+            std::cerr << "No golden manifest at " << manifestFile.getFullPathName()
+                      << "; write one with --golden-render on the reference platform" << std::endl;
+            return 1;
+        }
+
+        juce::StringArray manifestLines { "# Written by SynthRender --golden-render: scenario, channels, samples, FNV-1a hash" };
+
+        for (auto& scenario : createScenarios())
+        {
+            RenderKernels::setActiveLevel (RenderKernels::Level::reference);
+            auto reference = render (scenario, settings);
+
+            if (updateReferences)
+            {
+                manifestLines.add (toManifestLine (scenario.name, reference));
+                auto file = directory.getChildFile (scenario.name + ".wav");
+
+                if (! writeWavFile (file, reference, settings.sampleRate))
+                {
+                    std::cerr << "Couldn't write " << file.getFullPathName() << std::endl;
+                    ++failures;
+                }
+
+                continue;
+            }
+
+            for (auto level : RenderKernels::getSupportedLevels())
+            {
+                RenderKernels::setActiveLevel (level);
+                juce::String reason;
+
+                if (level == RenderKernels::Level::reference)
+                {
+                    auto entry = manifest.find (scenario.name);
+
+                    if (entry == manifest.end())
+                        reason = "not in the manifest";
+                    else if (matchesManifest (entry->second, reference, reason)
+                              && scenario.sound == EnginePreset::sineSound
+                              && ! matches (reference, renderStatic (scenario, settings), { true, 0.0 }, reason))
+                        reason = "static synthesiser: " + (reason.isEmpty() ? juce::String ("mismatch") : reason);
+                }
+                else if (! matches (reference, render (scenario, settings), getToleranceFor (level), reason))
+                {
+                    reason = reason.isEmpty() ? "mismatch" : reason;
+                }
+
+                std::cout << (reason.isEmpty() ? "PASS " : "FAIL ") << RenderKernels::getActive().name
+                          << " " << scenario.name
+                          << (reason.isEmpty() ? juce::String() : " (" + reason + ")") << std::endl;
+
+                if (reason.isNotEmpty())
+                    ++failures;
+            }
+        }
+
+        if (updateReferences && ! manifestFile.replaceWithText (manifestLines.joinIntoString ("\n") + "\n"))
+        {
+            std::cerr << "Couldn't write " << manifestFile.getFullPathName() << std::endl;
+            ++failures;
+        }
+
+        RenderKernels::setActiveLevel (previousLevel);
+        return failures == 0 ? 0 : 1;
+    }
+}
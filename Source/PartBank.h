@@ -0,0 +1,144 @@
+/*
+  ==============================================================================
+
+    Sixteen parts, one per MIDI channel, each with its own sound, level, pan
+    and polyphony limit. Every part plays from the same pool of voices.
+
+    PartSynthesiser holds each part to its limit when it picks a voice. The
+    voices of a part sum into that part's lane, so level and pan are applied
+    to whole parts when the lanes are mixed into the output.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+class PartBank
+{
+public:
+    static constexpr int numParts = 16;
+    static constexpr int defaultPolyphony = 64;
+
+    struct Settings
+    {
+        int sound = 0;
+        float level = 1.0f, pan = 0.0f;
+        int polyphony = defaultPolyphony;
+    };
+
+    PartBank() = default;
+
+    //==============================================================================
+    void set (int part, const Settings& settings)
+    {
+        auto& p = parts[(size_t) part];
+        p.requestedSound = settings.sound;
+        p.level = settings.level;
+        p.pan = juce::jlimit (-1.0f, 1.0f, settings.pan);
+        p.polyphony = juce::jmax (1, settings.polyphony);
+    }
+
+    Settings get (int part) const
+    {
+        auto& p = parts[(size_t) part];
+        return { p.requestedSound, p.level, p.pan, p.polyphony };
+    }
+
+    void setSound (int part, int slot)           { parts[(size_t) part].requestedSound = slot; }
+    int getPolyphony (int part) const noexcept   { return parts[(size_t) part].polyphony; }
+
+    //==============================================================================
+    // Sound changes take effect here, at the start of a block. Audio thread only.
+    void beginBlock() noexcept
+    {
+        for (auto& p : parts)
+            p.activeSound = p.requestedSound.load();
+
+        usedLanes = 0;
+    }
+
+    bool isSoundSelected (int midiChannel, int slot) const noexcept
+    {
+        return midiChannel >= 1 && midiChannel <= numParts
+                && parts[(size_t) midiChannel - 1].activeSound.load() == slot;
+    }
+
+    // Gains for the left and right side. The pan is a balance control, so a
+    // centred part at full level passes through untouched.
+    void getGains (int part, float& left, float& right) const noexcept
+    {
+        auto& p = parts[(size_t) part];
+        auto level = p.level.load(), pan = p.pan.load();
+
+        left  = level * juce::jmin (1.0f, 1.0f - pan);
+        right = level * juce::jmin (1.0f, 1.0f + pan);
+    }
+
+    // The voices mark the part lanes they write to, so that only those get
+    // mixed and cleared.
+    void markLaneUsed (int part) noexcept       { usedLanes |= 1u << part; }
+    juce::uint32 getUsedLanes() const noexcept  { return usedLanes; }
+
+    static int getPart (const juce::SynthesiserVoice& voice) noexcept
+    {
+        for (int channel = 1; channel <= numParts; ++channel)
+            if (voice.isPlayingChannel (channel))
+                return channel - 1;
+
+        return 0;
+    }
+
+private:
+    struct Part
+    {
+        std::atomic<int> requestedSound { 0 }, activeSound { 0 };
+        std::atomic<float> level { 1.0f }, pan { 0.0f };
+        std::atomic<int> polyphony { defaultPolyphony };
+    };
+
+    std::array<Part, numParts> parts;
+    juce::uint32 usedLanes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (PartBank)
+};
+
+//==============================================================================
+// A juce::Synthesiser that won't let a part hold more voices than its limit.
+// A part at its limit steals its own oldest voice that can play the sound,
+// and the note is dropped if it has none.
+class PartSynthesiser   : public juce::Synthesiser
+{
+public:
+    explicit PartSynthesiser (const PartBank& partsToUse) : parts (partsToUse) {}
+
+protected:
+    juce::SynthesiserVoice* findFreeVoice (juce::SynthesiserSound* sound, int midiChannel,
+                                           int midiNoteNumber, bool stealIfNoneAvailable) const override
+    {
+        if (midiChannel >= 1 && midiChannel <= PartBank::numParts)
+        {
+            auto numInPart = 0;
+            juce::SynthesiserVoice* oldest = nullptr;
+
+            for (auto* voice : voices)
+            {
+                if (voice->isVoiceActive() && voice->isPlayingChannel (midiChannel))
+                {
+                    ++numInPart;
+
+                    if (voice->canPlaySound (sound) && (oldest == nullptr || voice->wasStartedBefore (*oldest)))
+                        oldest = voice;
+                }
+            }
+
+            if (numInPart >= parts.getPolyphony (midiChannel - 1))
+                return oldest;
+        }
+
+        return juce::Synthesiser::findFreeVoice (sound, midiChannel, midiNoteNumber, stealIfNoneAvailable);
+    }
+
+private:
+    const PartBank& parts;
+};
@@ -0,0 +1,228 @@
+/*
+  ==============================================================================
+
+    Opt-in real-time setup for the thread that calls getNextAudioBlock, for
+    Linux, where the device backend leaves scheduling as it finds it.
+
+    The thread asks for SCHED_FIFO and is pinned to the chosen cores (or to
+    the kernel's isolated cores if none are given) from inside the first
+    callback, since both only apply to the calling thread. It also touches
+    a stretch of its stack so that those pages are already mapped. Memory is
+    locked with mlockall once the engine has been prepared: only the pages
+    mapped by then, so later mappings such as sample files aren't pulled into
+    RAM whole, and allocations past the memlock limit don't start failing.
+
+    Nothing fails hard: whatever couldn't be had is listed in the report.
+    Scheduling is requested directly; rtkit would need D-Bus, which this
+    build doesn't link, so without CAP_SYS_NICE or an rtprio limit the
+    request is refused and reported.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#if JUCE_LINUX
+ #include <pthread.h>
+ #include <sched.h>
+ #include <sys/mman.h>
+ #include <sys/resource.h>
+#endif
+
+//==============================================================================
+class RealtimeSetup
+{
+public:
+    struct Options
+    {
+        bool enabled = false;
+        int priority = 70;          // SCHED_FIFO, 1 to 99
+        juce::Array<int> cpus;      // empty to use the isolated cores, if there are any
+        bool lockMemory = true;
+    };
+
+    RealtimeSetup() = default;
+
+    // --realtime turns it on; --rt-priority=<n>, --cpus=<list> and --no-mlock
+    // adjust it.
+    static Options optionsFromArguments (const juce::ArgumentList& args)
+    {
+        Options o;
+        o.enabled = args.containsOption ("--realtime");
+        o.lockMemory = ! args.containsOption ("--no-mlock");
+
+        if (args.containsOption ("--rt-priority"))
+            o.priority = args.getValueForOption ("--rt-priority").getIntValue();
+
+        if (args.containsOption ("--cpus"))
+            o.cpus = parseCpuList (args.getValueForOption ("--cpus"));
+
+        return o;
+    }
+
+    // Message thread, before the audio starts.
+    void setOptions (const Options& newOptions)
+    {
+        options = newOptions;
+        options.priority = juce::jlimit (1, 99, options.priority);
+
+        if (options.cpus.isEmpty())
+            options.cpus = parseCpuList (juce::File ("/sys/devices/system/cpu/isolated").loadFileAsString());
+
+        schedulingResult = affinityResult = memoryResult = notTried;
+        pending = options.enabled;
+    }
+
+    // Audio thread, at the top of every callback. Only the first one after
+    // setOptions() does anything, and that makes a few system calls.
+    void applyIfPending() noexcept
+    {
+        if (pending.load (std::memory_order_relaxed) && pending.exchange (false))
+            applyToCurrentThread();
+    }
+
+    // Whether lockMemoryIfRequested() will try to lock anything.
+    bool willLockMemory() const noexcept      { return options.enabled && options.lockMemory; }
+
+    // Once the engine has allocated everything it will use.
+    void lockMemoryIfRequested()
+    {
+        if (! willLockMemory())
+            return;
+
+       #if JUCE_LINUX
+        memoryResult = mlockall (MCL_CURRENT) == 0 ? 0 : errno;
+       #else
+        memoryResult = ENOSYS;
+       #endif
+    }
+
+    // One line per capability, saying what was obtained and what wasn't.
+    juce::StringArray getReport() const
+    {
+        juce::StringArray report;
+
+        if (! options.enabled)
+            return report;
+
+        auto scheduling = schedulingResult.load();
+
+        if (scheduling == notTried)
+            report.add ("Real-time scheduling: waiting for the first audio callback");
+        else if (scheduling == 0)
+            report.add ("Real-time scheduling: SCHED_FIFO at priority " + juce::String (options.priority));
+        else
+            report.add ("Real-time scheduling: not obtained (" + describe (scheduling)
+                          + "); needs CAP_SYS_NICE or an rtprio limit, as rtkit isn't supported in this build");
+
+        auto affinity = affinityResult.load();
+
+        if (options.cpus.isEmpty())
+            report.add ("CPU pinning: not done, no CPUs were given and none are isolated");
+        else if (affinity == 0)
+            report.add ("CPU pinning: audio thread pinned to " + describeCpus());
+        else if (affinity != notTried)
+            report.add ("CPU pinning: couldn't pin to " + describeCpus() + " (" + describe (affinity) + ")");
+
+        auto memory = memoryResult.load();
+
+        if (memory == 0)
+            report.add ("Memory locking: pages mapped when the engine was prepared are locked");
+        else if (memory != notTried)
+            report.add ("Memory locking: not obtained (" + describe (memory) + "); needs CAP_IPC_LOCK or a large enough memlock limit");
+
+        return report;
+    }
+
+    // Parses the kernel's CPU list format, as in "2-3,6".
+    static juce::Array<int> parseCpuList (const juce::String& text)
+    {
+        juce::Array<int> cpus;
+
+        for (auto& item : juce::StringArray::fromTokens (text.trim(), ",", {}))
+        {
+            auto first = item.upToFirstOccurrenceOf ("-", false, false).trim();
+            auto last = item.containsChar ('-') ? item.fromFirstOccurrenceOf ("-", false, false).trim() : first;
+
+            if (first.containsOnly ("0123456789") && last.containsOnly ("0123456789") && first.isNotEmpty() && last.isNotEmpty())
+                for (auto cpu = first.getIntValue(); cpu <= juce::jmin (last.getIntValue(), 1023); ++cpu)
+                    cpus.addIfNotAlreadyThere (cpu);
+        }
+
+        return cpus;
+    }
+
+private:
+    static constexpr int notTried = -1;
+    static constexpr int stackBytesToTouch = 128 * 1024;
+
+    void applyToCurrentThread() noexcept
+    {
+       #if JUCE_LINUX
+        // An rtprio grant in limits.conf only raises the hard limit.
+        rlimit limit;
+
+        if (getrlimit (RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+        {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit (RLIMIT_RTPRIO, &limit);
+        }
+
+        sched_param param {};
+        param.sched_priority = options.priority;
+        schedulingResult = pthread_setschedparam (pthread_self(), SCHED_FIFO, &param);
+
+        if (! options.cpus.isEmpty())
+        {
+            cpu_set_t set;
+            CPU_ZERO (&set);
+
+            for (auto cpu : options.cpus)
+                if (cpu < CPU_SETSIZE)
+                    CPU_SET ((size_t) cpu, &set);
+
+            affinityResult = pthread_setaffinity_np (pthread_self(), sizeof (set), &set);
+        }
+
+        touchStack();
+       #else
+        schedulingResult = ENOSYS;
+
+        if (! options.cpus.isEmpty())
+            affinityResult = ENOSYS;
+       #endif
+    }
+
+   #if JUCE_LINUX
+    // Maps the stack pages that deep calls in the render will use.
+    __attribute__ ((noinline)) static void touchStack() noexcept
+    {
+        volatile char stack[stackBytesToTouch];
+
+        for (int i = 0; i < stackBytesToTouch; i += 1024)
+            stack[i] = 0;
+    }
+   #endif
+
+    static juce::String describe (int error)
+    {
+        return std::strerror (error);
+    }
+
+    juce::String describeCpus() const
+    {
+        juce::StringArray names;
+
+        for (auto cpu : options.cpus)
+            names.add (juce::String (cpu));
+
+        return "CPU " + names.joinIntoString (",");
+    }
+
+    //==============================================================================
+    Options options;
+    std::atomic<bool> pending { false };
+    std::atomic<int> schedulingResult { notTried }, affinityResult { notTried }, memoryResult { notTried };
+
+    JUCE_DECLARE_NON_COPYABLE (RealtimeSetup)
+};
@@ -0,0 +1,819 @@
+/*
+  ==============================================================================
+
+    Oscillator, envelope and mix kernels for the voices, compiled for several
+    instruction set levels and picked at startup from the CPU's feature flags.
+
+    The reference kernels reproduce the original per-sample std::sin loop
+    exactly. The other levels share one approximation that the compiler
+    vectorises for whichever ISA the wrapper function targets.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+struct VoiceRenderState
+{
+    double currentAngle = 0.0, angleDelta = 0.0, level = 0.0, tailOff = 0.0;
+    double decay = 0.0;
+};
+
+// Eight voices' worth of state-variable filter, laid out so that one sample of
+// all eight lanes is a single vector.
+struct FilterLaneGroup
+{
+    static constexpr int numLanes = 8;
+
+    float a1[numLanes] {}, a2[numLanes] {}, a3[numLanes] {};
+    float ic1eq[numLanes] {}, ic2eq[numLanes] {};
+};
+
+// Four FM operators for each of eight voices. Phases are 32-bit fixed point so
+// that they wrap for free, and each operator's envelope glides exponentially
+// towards its target.
+struct FmLaneGroup
+{
+    static constexpr int numLanes = 8, numOperators = 4;
+
+    juce::uint32 phase[numOperators][numLanes] {}, increment[numOperators][numLanes] {};
+    float envelope[numOperators][numLanes] {}, target[numOperators][numLanes] {}, coefficient[numOperators][numLanes] {};
+    float feedback[numLanes] {}, history[2][numLanes] {};
+};
+
+// Eight partials of an additive voice, each a unit phasor (re, im) turned by a
+// fixed rotation every sample.
+struct PartialGroup
+{
+    static constexpr int numLanes = 8;
+
+    float re[numLanes] {}, im[numLanes] {}, cosine[numLanes] {}, sine[numLanes] {}, amplitude[numLanes] {};
+};
+
+// Which operators modulate each operator, as a bit mask, and which ones are
+// heard. An operator is only modulated by higher-numbered ones, so working
+// from the top down always has the modulators ready. The top operator can also
+// modulate itself through its feedback.
+struct FmAlgorithm
+{
+    juce::uint8 modulators[FmLaneGroup::numOperators];
+    juce::uint8 carriers;
+};
+
+//==============================================================================
+namespace RenderKernelsDetail
+{
+    static constexpr double twoPi = juce::MathConstants<double>::twoPi;
+    static constexpr double tailOffThreshold = 0.005;
+    static constexpr int subBlockSize = 64;
+    static constexpr int sineTableSize = 4096;
+
+    //==============================================================================
+    static void referenceOscillator (float* dest, int numSamples, VoiceRenderState& s)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            dest[i] = (float) (std::sin (s.currentAngle) * s.level);
+            s.currentAngle += s.angleDelta;
+        }
+    }
+
+    static int referenceTailOff (float* dest, int numSamples, VoiceRenderState& s)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            dest[i] = (float) (std::sin (s.currentAngle) * s.level * s.tailOff);
+            s.currentAngle += s.angleDelta;
+            s.tailOff *= s.decay;
+
+            if (s.tailOff <= tailOffThreshold)
+                return i + 1;
+        }
+
+        return numSamples;
+    }
+
+    static void referenceMix (float* const* channels, int numChannels, int startSample,
+                              const float* source, int numSamples)
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < numSamples; ++i)
+                channels[ch][startSample + i] += source[i];
+    }
+
+    // Adds every lane into every channel, each with its own gain per side.
+    // Channel 0 takes a lane's first gain and every other channel its second.
+    // With unit gains this is exactly calling referenceMix() for each lane in
+    // turn.
+    static void referenceMixLanes (float* const* channels, int numChannels, int startSample,
+                                   const float* const* lanes, const float* gains, int numLanes, int numSamples)
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto side = juce::jmin (ch, 1);
+
+            for (int lane = 0; lane < numLanes; ++lane)
+                for (int i = 0; i < numSamples; ++i)
+                    channels[ch][startSample + i] += lanes[lane][i] * gains[lane * 2 + side];
+        }
+    }
+
+    //==============================================================================
+    // sin (2 * pi * x) for x in [0, 1), written without branches or library
+    // calls so that it vectorises. The error is around 1e-7.
+    forcedinline float fastSin2Pi (float x) noexcept
+    {
+        auto y = x - 0.5f;
+        auto a = y < 0.0f ? -y : y;
+        auto folded = a < 0.5f - a ? a : 0.5f - a;
+        auto w = (float) twoPi * folded;
+        auto w2 = w * w;
+
+        auto s = w * (1.0f + w2 * (-1.0f / 6.0f + w2 * (1.0f / 120.0f + w2 * (-1.0f / 5040.0f
+                        + w2 * (1.0f / 362880.0f + w2 * (-1.0f / 39916800.0f))))));
+
+        return y < 0.0f ? s : -s;
+    }
+
+    forcedinline void approxSine (float* dest, int numSamples, double& phase, double cyclesPerSample,
+                                  float level) noexcept
+    {
+        // The phase is re-based in double precision every sub-block so that the
+        // float ramp inside it stays small enough to be accurate.
+        for (int start = 0; start < numSamples; start += subBlockSize)
+        {
+            auto n = juce::jmin (subBlockSize, numSamples - start);
+            auto p0 = (float) phase;
+            auto inc = (float) cyclesPerSample;
+            auto* d = dest + start;
+
+            for (int i = 0; i < n; ++i)
+            {
+                auto x = p0 + inc * (float) i;
+                x -= (float) (int) x;
+                d[i] = level * fastSin2Pi (x);
+            }
+
+            phase += cyclesPerSample * n;
+            phase -= std::floor (phase);
+        }
+    }
+
+    forcedinline void approxOscillator (float* dest, int numSamples, VoiceRenderState& s) noexcept
+    {
+        auto phase = s.currentAngle / twoPi;
+        phase -= std::floor (phase);
+
+        approxSine (dest, numSamples, phase, s.angleDelta / twoPi, (float) s.level);
+        s.currentAngle = phase * twoPi;
+    }
+
+    forcedinline int approxTailOff (float* dest, int numSamples, VoiceRenderState& s) noexcept
+    {
+        // The geometric tail-off is evaluated in closed form: we know up front how
+        // many samples are left before it crosses the threshold.
+        auto numToRender = numSamples;
+        auto finishes = false;
+
+        if (s.decay < 1.0)
+        {
+            auto remaining = std::ceil (std::log (tailOffThreshold / s.tailOff) / std::log (s.decay));
+
+            if (remaining <= (double) numSamples)
+            {
+                numToRender = juce::jmax (1, (int) remaining);
+                finishes = true;
+            }
+        }
+
+        approxOscillator (dest, numToRender, s);
+
+        alignas (64) float powers[subBlockSize];
+        powers[0] = 1.0f;
+
+        for (int i = 1; i < 8; ++i)
+            powers[i] = powers[i - 1] * (float) s.decay;
+
+        auto step = powers[7] * (float) s.decay;
+
+        for (int row = 8; row < subBlockSize; row += 8)
+            for (int i = 0; i < 8; ++i)
+                powers[row + i] = powers[row + i - 8] * step;
+
+        auto rowStep = (float) std::pow (s.decay, (double) subBlockSize);
+        auto env = (float) s.tailOff;
+
+        for (int start = 0; start < numToRender; start += subBlockSize)
+        {
+            auto n = juce::jmin (subBlockSize, numToRender - start);
+            auto* d = dest + start;
+
+            for (int i = 0; i < n; ++i)
+                d[i] *= env * powers[i];
+
+            env *= rowStep;
+        }
+
+        s.tailOff *= std::pow (s.decay, (double) numToRender);
+
+        if (finishes)
+            s.tailOff = juce::jmin (s.tailOff, tailOffThreshold);
+
+        return numToRender;
+    }
+
+    // Trapezoidal (TPT) state-variable lowpass over interleaved samples, one
+    // lane per voice. Every operation works on all eight lanes at once; with
+    // GCC and Clang that's spelled with vector extensions, because the
+    // auto-vectoriser won't reliably turn the per-lane loop into one.
+    forcedinline void svfLowpass (float* interleaved, int numSamples, FilterLaneGroup& g) noexcept
+    {
+        constexpr int n = FilterLaneGroup::numLanes;
+
+       #if JUCE_GCC || JUCE_CLANG
+        typedef float Lanes __attribute__ ((vector_size (sizeof (float) * n)));
+
+        Lanes a1, a2, a3, ic1, ic2, x;
+        std::memcpy (&a1,  g.a1,    sizeof (Lanes));
+        std::memcpy (&a2,  g.a2,    sizeof (Lanes));
+        std::memcpy (&a3,  g.a3,    sizeof (Lanes));
+        std::memcpy (&ic1, g.ic1eq, sizeof (Lanes));
+        std::memcpy (&ic2, g.ic2eq, sizeof (Lanes));
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            std::memcpy (&x, interleaved + i * n, sizeof (Lanes));
+
+            auto v3 = x - ic2;
+            auto v1 = a1 * ic1 + a2 * v3;
+            auto v2 = ic2 + a2 * ic1 + a3 * v3;
+            ic1 = 2.0f * v1 - ic1;
+            ic2 = 2.0f * v2 - ic2;
+
+            std::memcpy (interleaved + i * n, &v2, sizeof (Lanes));
+        }
+
+        std::memcpy (g.ic1eq, &ic1, sizeof (Lanes));
+        std::memcpy (g.ic2eq, &ic2, sizeof (Lanes));
+       #else
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto* x = interleaved + i * n;
+
+            for (int l = 0; l < n; ++l)
+            {
+                auto v3 = x[l] - g.ic2eq[l];
+                auto v1 = g.a1[l] * g.ic1eq[l] + g.a2[l] * v3;
+                auto v2 = g.ic2eq[l] + g.a2[l] * g.ic1eq[l] + g.a3[l] * v3;
+                g.ic1eq[l] = 2.0f * v1 - g.ic1eq[l];
+                g.ic2eq[l] = 2.0f * v2 - g.ic2eq[l];
+                x[l] = v2;
+            }
+        }
+       #endif
+    }
+
+    static void referenceFilter (float* interleaved, int numSamples, FilterLaneGroup& g)
+    {
+        svfLowpass (interleaved, numSamples, g);
+    }
+
+    //==============================================================================
+    // One cycle of a sine, plus a guard point for the interpolation. Shared by
+    // every FM operator.
+    inline const float* getSineTable()
+    {
+        static const auto table = []
+        {
+            std::array<float, sineTableSize + 1> t;
+
+            for (int i = 0; i <= sineTableSize; ++i)
+                t[(size_t) i] = (float) std::sin (twoPi * i / sineTableSize);
+
+            return t;
+        }();
+
+        return table.data();
+    }
+
+    forcedinline float sineTableLookup (const float* table, float cycles) noexcept
+    {
+        auto pos = (cycles - std::floor (cycles)) * (float) sineTableSize;
+        auto index = (int) pos;
+        auto frac = pos - (float) index;
+        index &= sineTableSize - 1;
+
+        return table[index] + frac * (table[index + 1] - table[index]);
+    }
+
+    // Runs the operator stacks of eight voices, writing the sum of the carriers
+    // for each voice as interleaved samples. Operator outputs are in cycles of
+    // phase when they modulate, so an envelope level of 1 is a deviation of
+    // one cycle. The table lookups are the only per-lane step.
+    forcedinline void fmOperatorStack (float* interleaved, int numSamples, FmLaneGroup& g,
+                                       const FmAlgorithm& algorithm) noexcept
+    {
+        constexpr int n = FmLaneGroup::numLanes, numOps = FmLaneGroup::numOperators, top = numOps - 1;
+        constexpr float phaseScale = 1.0f / 4294967296.0f;
+        const auto* table = getSineTable();
+
+       #if JUCE_GCC || JUCE_CLANG
+        typedef float        Lanes      __attribute__ ((vector_size (sizeof (float) * n)));
+        typedef juce::int32  IntLanes   __attribute__ ((vector_size (sizeof (juce::int32) * n)));
+        typedef juce::uint32 PhaseLanes __attribute__ ((vector_size (sizeof (juce::uint32) * n)));
+
+        PhaseLanes phase[numOps], inc[numOps];
+        Lanes env[numOps], target[numOps], coeff[numOps], fb, h0, h1;
+
+        for (int op = 0; op < numOps; ++op)
+        {
+            std::memcpy (&phase[op],  g.phase[op],       sizeof (PhaseLanes));
+            std::memcpy (&inc[op],    g.increment[op],   sizeof (PhaseLanes));
+            std::memcpy (&env[op],    g.envelope[op],    sizeof (Lanes));
+            std::memcpy (&target[op], g.target[op],      sizeof (Lanes));
+            std::memcpy (&coeff[op],  g.coefficient[op], sizeof (Lanes));
+        }
+
+        std::memcpy (&fb, g.feedback,   sizeof (Lanes));
+        std::memcpy (&h0, g.history[0], sizeof (Lanes));
+        std::memcpy (&h1, g.history[1], sizeof (Lanes));
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            Lanes out[numOps], sum = {};
+
+            for (int op = top; op >= 0; --op)
+            {
+                // The phase as signed cycles in [-0.5, 0.5), plus the modulation.
+                auto x = __builtin_convertvector ((IntLanes) phase[op], Lanes) * phaseScale;
+
+                for (int m = op + 1; m < numOps; ++m)
+                    if ((algorithm.modulators[op] >> m) & 1)
+                        x += out[m];
+
+                if (op == top)
+                    x += fb * (h0 + h1) * 0.5f;
+
+                auto whole = __builtin_convertvector (__builtin_convertvector (x, IntLanes), Lanes);
+                whole += __builtin_convertvector (x < whole, Lanes);   // truncation to floor
+
+                auto pos = (x - whole) * (float) sineTableSize;
+                auto index = __builtin_convertvector (pos, IntLanes);
+                auto frac = pos - __builtin_convertvector (index, Lanes);
+                index &= sineTableSize - 1;
+
+                Lanes a, b;
+
+                for (int l = 0; l < n; ++l)
+                {
+                    a[l] = table[index[l]];
+                    b[l] = table[index[l] + 1];
+                }
+
+                auto sine = a + frac * (b - a);
+
+                if (op == top)
+                {
+                    h1 = h0;
+                    h0 = sine;
+                }
+
+                out[op] = sine * env[op];
+
+                if ((algorithm.carriers >> op) & 1)
+                    sum += out[op];
+
+                env[op] = target[op] + (env[op] - target[op]) * coeff[op];
+                phase[op] += inc[op];
+            }
+
+            std::memcpy (interleaved + i * n, &sum, sizeof (Lanes));
+        }
+
+        for (int op = 0; op < numOps; ++op)
+        {
+            std::memcpy (g.phase[op],    &phase[op], sizeof (PhaseLanes));
+            std::memcpy (g.envelope[op], &env[op],   sizeof (Lanes));
+        }
+
+        std::memcpy (g.history[0], &h0, sizeof (Lanes));
+        std::memcpy (g.history[1], &h1, sizeof (Lanes));
+       #else
+        for (int i = 0; i < numSamples; ++i)
+        {
+            for (int l = 0; l < n; ++l)
+            {
+                float out[numOps], sum = 0.0f;
+
+                for (int op = top; op >= 0; --op)
+                {
+                    auto x = (float) (juce::int32) g.phase[op][l] * phaseScale;
+
+                    for (int m = op + 1; m < numOps; ++m)
+                        if ((algorithm.modulators[op] >> m) & 1)
+                            x += out[m];
+
+                    if (op == top)
+                        x += g.feedback[l] * (g.history[0][l] + g.history[1][l]) * 0.5f;
+
+                    auto sine = sineTableLookup (table, x);
+
+                    if (op == top)
+                    {
+                        g.history[1][l] = g.history[0][l];
+                        g.history[0][l] = sine;
+                    }
+
+                    out[op] = sine * g.envelope[op][l];
+
+                    if ((algorithm.carriers >> op) & 1)
+                        sum += out[op];
+
+                    g.envelope[op][l] = g.target[op][l] + (g.envelope[op][l] - g.target[op][l]) * g.coefficient[op][l];
+                    g.phase[op][l] += g.increment[op][l];
+                }
+
+                interleaved[i * n + l] = sum;
+            }
+        }
+       #endif
+    }
+
+    // Writes the sum of the partials' sines, one group of eight partials per
+    // vector. Each group stays in registers for a whole sub-block while its
+    // contributions are accumulated per sample, and its phasors are pulled back
+    // onto the unit circle with a Newton step at the end of every sub-block so
+    // that rounding can't make them grow or shrink.
+    forcedinline void partialBank (float* dest, int numSamples, PartialGroup* groups, int numGroups) noexcept
+    {
+        constexpr int n = PartialGroup::numLanes;
+
+       #if JUCE_GCC || JUCE_CLANG
+        typedef float Lanes __attribute__ ((vector_size (sizeof (float) * n)));
+
+        for (int start = 0; start < numSamples; start += subBlockSize)
+        {
+            auto num = juce::jmin (subBlockSize, numSamples - start);
+            Lanes sums[subBlockSize] = {};
+
+            for (int grp = 0; grp < numGroups; ++grp)
+            {
+                auto& g = groups[grp];
+                Lanes re, im, c, s, a;
+                std::memcpy (&re, g.re,        sizeof (Lanes));
+                std::memcpy (&im, g.im,        sizeof (Lanes));
+                std::memcpy (&c,  g.cosine,    sizeof (Lanes));
+                std::memcpy (&s,  g.sine,      sizeof (Lanes));
+                std::memcpy (&a,  g.amplitude, sizeof (Lanes));
+
+                for (int i = 0; i < num; ++i)
+                {
+                    sums[i] += a * im;
+
+                    auto nextRe = re * c - im * s;
+                    im = re * s + im * c;
+                    re = nextRe;
+                }
+
+                auto scale = 1.5f - 0.5f * (re * re + im * im);
+                re *= scale;
+                im *= scale;
+
+                std::memcpy (g.re, &re, sizeof (Lanes));
+                std::memcpy (g.im, &im, sizeof (Lanes));
+            }
+
+            for (int i = 0; i < num; ++i)
+            {
+                auto sum = 0.0f;
+
+                for (int l = 0; l < n; ++l)
+                    sum += sums[i][l];
+
+                dest[start + i] = sum;
+            }
+        }
+       #else
+        std::fill (dest, dest + numSamples, 0.0f);
+
+        for (int grp = 0; grp < numGroups; ++grp)
+        {
+            auto& g = groups[grp];
+
+            for (int start = 0; start < numSamples; start += subBlockSize)
+            {
+                auto num = juce::jmin (subBlockSize, numSamples - start);
+
+                for (int l = 0; l < n; ++l)
+                {
+                    auto re = g.re[l], im = g.im[l];
+
+                    for (int i = 0; i < num; ++i)
+                    {
+                        dest[start + i] += g.amplitude[l] * im;
+
+                        auto nextRe = re * g.cosine[l] - im * g.sine[l];
+                        im = re * g.sine[l] + im * g.cosine[l];
+                        re = nextRe;
+                    }
+
+                    auto scale = 1.5f - 0.5f * (re * re + im * im);
+                    g.re[l] = re * scale;
+                    g.im[l] = im * scale;
+                }
+            }
+        }
+       #endif
+    }
+
+    static void referencePartials (float* dest, int numSamples, PartialGroup* groups, int numGroups)
+    {
+        partialBank (dest, numSamples, groups, numGroups);
+    }
+
+    static void referenceFm (float* interleaved, int numSamples, FmLaneGroup& g, const FmAlgorithm& a)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            for (int l = 0; l < FmLaneGroup::numLanes; ++l)
+            {
+                constexpr int numOps = FmLaneGroup::numOperators, top = numOps - 1;
+                float out[numOps], sum = 0.0f;
+
+                for (int op = top; op >= 0; --op)
+                {
+                    auto x = (float) (juce::int32) g.phase[op][l] * (1.0f / 4294967296.0f);
+
+                    for (int m = op + 1; m < numOps; ++m)
+                        if ((a.modulators[op] >> m) & 1)
+                            x += out[m];
+
+                    if (op == top)
+                        x += g.feedback[l] * (g.history[0][l] + g.history[1][l]) * 0.5f;
+
+                    auto sine = (float) std::sin (twoPi * x);
+
+                    if (op == top)
+                    {
+                        g.history[1][l] = g.history[0][l];
+                        g.history[0][l] = sine;
+                    }
+
+                    out[op] = sine * g.envelope[op][l];
+
+                    if ((a.carriers >> op) & 1)
+                        sum += out[op];
+
+                    g.envelope[op][l] = g.target[op][l] + (g.envelope[op][l] - g.target[op][l]) * g.coefficient[op][l];
+                    g.phase[op][l] += g.increment[op][l];
+                }
+
+                interleaved[i * FmLaneGroup::numLanes + l] = sum;
+            }
+        }
+    }
+
+    forcedinline void approxMix (float* const* channels, int numChannels, int startSample,
+                                 const float* source, int numSamples) noexcept
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* d = channels[ch] + startSample;
+
+            for (int i = 0; i < numSamples; ++i)
+                d[i] += source[i];
+        }
+    }
+
+    // Sixteen samples of the output are held in registers while every lane is
+    // added in, so the output is only read and written once however many
+    // lanes there are.
+    forcedinline void approxMixLanes (float* const* channels, int numChannels, int startSample,
+                                      const float* const* lanes, const float* gains, int numLanes, int numSamples) noexcept
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto side = ch < 1 ? ch : 1;
+            auto* d = channels[ch] + startSample;
+            int i = 0;
+
+           #if JUCE_GCC || JUCE_CLANG
+            constexpr int n = 4;
+            typedef float Lanes __attribute__ ((vector_size (sizeof (float) * n)));
+
+            for (; i + 4 * n <= numSamples; i += 4 * n)
+            {
+                Lanes sum[4], x;
+
+                for (int k = 0; k < 4; ++k)
+                    std::memcpy (&sum[k], d + i + k * n, sizeof (Lanes));
+
+                for (int lane = 0; lane < numLanes; ++lane)
+                {
+                    auto gain = gains[lane * 2 + side];
+
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        std::memcpy (&x, lanes[lane] + i + k * n, sizeof (Lanes));
+                        sum[k] += x * gain;
+                    }
+                }
+
+                for (int k = 0; k < 4; ++k)
+                    std::memcpy (d + i + k * n, &sum[k], sizeof (Lanes));
+            }
+           #endif
+
+            for (; i < numSamples; ++i)
+            {
+                auto sum = d[i];
+
+                for (int lane = 0; lane < numLanes; ++lane)
+                    sum += lanes[lane][i] * gains[lane * 2 + side];
+
+                d[i] = sum;
+            }
+        }
+    }
+}
+
+//==============================================================================
+#if JUCE_INTEL && (JUCE_GCC || JUCE_CLANG)
+ #define SYNTH_KERNEL_TARGET(isa)   __attribute__ ((target (isa)))
+ #define SYNTH_HAS_SSE2_KERNELS     1
+ #define SYNTH_HAS_AVX2_KERNELS     1
+ #define SYNTH_HAS_AVX512_KERNELS   1
+#elif JUCE_INTEL && JUCE_MSVC
+ // MSVC can't retarget a single function, so only what /arch enables is available.
+ #define SYNTH_KERNEL_TARGET(isa)
+ #define SYNTH_HAS_SSE2_KERNELS     1
+ #if defined (__AVX2__)
+  #define SYNTH_HAS_AVX2_KERNELS    1
+ #endif
+ #if defined (__AVX512F__)
+  #define SYNTH_HAS_AVX512_KERNELS  1
+ #endif
+#elif JUCE_ARM && (defined (__ARM_NEON) || defined (__ARM_NEON__) || JUCE_64BIT)
+ #define SYNTH_KERNEL_TARGET(isa)
+ #define SYNTH_HAS_NEON_KERNELS     1
+#endif
+
+#define SYNTH_DECLARE_KERNEL_SET(suffix, isa) \
+    SYNTH_KERNEL_TARGET (isa) static void oscillator##suffix (float* d, int n, VoiceRenderState& s)  { approxOscillator (d, n, s); } \
+    SYNTH_KERNEL_TARGET (isa) static int  tailOff##suffix (float* d, int n, VoiceRenderState& s)     { return approxTailOff (d, n, s); } \
+    SYNTH_KERNEL_TARGET (isa) static void mix##suffix (float* const* c, int nc, int st, const float* src, int n) { approxMix (c, nc, st, src, n); } \
+    SYNTH_KERNEL_TARGET (isa) static void mixLanes##suffix (float* const* c, int nc, int st, const float* const* l, const float* g, int nl, int n) { approxMixLanes (c, nc, st, l, g, nl, n); } \
+    SYNTH_KERNEL_TARGET (isa) static void filter##suffix (float* x, int n, FilterLaneGroup& g)      { svfLowpass (x, n, g); } \
+    SYNTH_KERNEL_TARGET (isa) static void fm##suffix (float* x, int n, FmLaneGroup& g, const FmAlgorithm& a) { fmOperatorStack (x, n, g, a); } \
+    SYNTH_KERNEL_TARGET (isa) static void partials##suffix (float* d, int n, PartialGroup* g, int ng) { partialBank (d, n, g, ng); }
+
+namespace RenderKernelsDetail
+{
+   #if SYNTH_HAS_SSE2_KERNELS
+    SYNTH_DECLARE_KERNEL_SET (SSE2, "sse2")
+   #endif
+   #if SYNTH_HAS_AVX2_KERNELS
+    SYNTH_DECLARE_KERNEL_SET (AVX2, "avx2,fma")
+   #endif
+   #if SYNTH_HAS_AVX512_KERNELS
+    SYNTH_DECLARE_KERNEL_SET (AVX512, "avx512f")
+   #endif
+   #if SYNTH_HAS_NEON_KERNELS
+    SYNTH_DECLARE_KERNEL_SET (NEON, "")
+   #endif
+}
+
+#undef SYNTH_DECLARE_KERNEL_SET
+
+//==============================================================================
+struct RenderKernels
+{
+    enum class Level
+    {
+        reference,
+        sse2,
+        avx2,
+        avx512,
+        neon
+    };
+
+    static constexpr int maxChunkSize = 256;
+
+    Level level;
+    const char* name;
+
+    void (*oscillator) (float* dest, int numSamples, VoiceRenderState&);
+    int  (*tailOff)    (float* dest, int numSamples, VoiceRenderState&);   // returns the number of samples written
+    void (*mix)        (float* const* channels, int numChannels, int startSample, const float* source, int numSamples);
+    void (*mixLanes)   (float* const* channels, int numChannels, int startSample,
+                        const float* const* lanes, const float* gains, int numLanes, int numSamples);
+    void (*filter)     (float* interleaved, int numSamples, FilterLaneGroup&);
+    void (*fm)         (float* interleaved, int numSamples, FmLaneGroup&, const FmAlgorithm&);
+    void (*partials)   (float* dest, int numSamples, PartialGroup* groups, int numGroups);
+
+    //==============================================================================
+    static const RenderKernels* forLevel (Level l)
+    {
+        using namespace RenderKernelsDetail;
+
+        static const RenderKernels reference { Level::reference, "reference", referenceOscillator, referenceTailOff, referenceMix, referenceMixLanes, referenceFilter, referenceFm, referencePartials };
+
+        switch (l)
+        {
+            case Level::reference:  return &reference;
+
+           #if SYNTH_HAS_SSE2_KERNELS
+            case Level::sse2:       { static const RenderKernels k { l, "sse2", oscillatorSSE2, tailOffSSE2, mixSSE2, mixLanesSSE2, filterSSE2, fmSSE2, partialsSSE2 }; return &k; }
+           #endif
+           #if SYNTH_HAS_AVX2_KERNELS
+            case Level::avx2:       { static const RenderKernels k { l, "avx2", oscillatorAVX2, tailOffAVX2, mixAVX2, mixLanesAVX2, filterAVX2, fmAVX2, partialsAVX2 }; return &k; }
+           #endif
+           #if SYNTH_HAS_AVX512_KERNELS
+            case Level::avx512:     { static const RenderKernels k { l, "avx512", oscillatorAVX512, tailOffAVX512, mixAVX512, mixLanesAVX512, filterAVX512, fmAVX512, partialsAVX512 }; return &k; }
+           #endif
+           #if SYNTH_HAS_NEON_KERNELS
+            case Level::neon:       { static const RenderKernels k { l, "neon", oscillatorNEON, tailOffNEON, mixNEON, mixLanesNEON, filterNEON, fmNEON, partialsNEON }; return &k; }
+           #endif
+
+            default:                break;
+        }
+
+        return nullptr;
+    }
+
+    static bool isSupported (Level l)
+    {
+        if (forLevel (l) == nullptr)
+            return false;
+
+        switch (l)
+        {
+            case Level::reference:  return true;
+            case Level::sse2:       return juce::SystemStats::hasSSE2();
+            case Level::avx2:       return juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3();
+            case Level::avx512:     return juce::SystemStats::hasAVX512F();
+            case Level::neon:       return juce::SystemStats::hasNeon();
+            default:                break;
+        }
+
+        return false;
+    }
+
+    static juce::Array<Level> getSupportedLevels()
+    {
+        juce::Array<Level> levels;
+
+        for (auto l : { Level::reference, Level::sse2, Level::avx2, Level::avx512, Level::neon })
+            if (isSupported (l))
+                levels.add (l);
+
+        return levels;
+    }
+
+    static Level getBestSupportedLevel()
+    {
+        return getSupportedLevels().getLast();
+    }
+
+    static bool levelFromName (const juce::String& name, Level& result)
+    {
+        for (auto l : { Level::reference, Level::sse2, Level::avx2, Level::avx512, Level::neon })
+        {
+            if (auto* k = forLevel (l))
+            {
+                if (name.equalsIgnoreCase (k->name))
+                {
+                    result = l;
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    //==============================================================================
+    // The kernels used by every voice. Chosen once at startup, or forced from the
+    // command line with --isa=<name>.
+    static const RenderKernels& getActive()
+    {
+        return *activeKernels().load (std::memory_order_relaxed);
+    }
+
+    static bool setActiveLevel (Level l)
+    {
+        if (! isSupported (l))
+            return false;
+
+        activeKernels().store (forLevel (l));
+        return true;
+    }
+
+private:
+    static std::atomic<const RenderKernels*>& activeKernels()
+    {
+        static std::atomic<const RenderKernels*> active { forLevel (getBestSupportedLevel()) };
+        return active;
+    }
+};
@@ -0,0 +1,742 @@
+/*
+  ==============================================================================
+
+    Disk streaming for the sampler voices.
+
+    A SampleLibrary is a folder of WAV/FLAC files, one zone per file. Loading
+    one only reads the file headers, and closes each file again. The
+    SampleStreamer's background thread then loads a short head of every zone
+    into RAM, and while a note plays it reads the rest of the zone into that
+    voice's ring buffer. WAVs are read through a memory-mapped reader, so any
+    page faults land on the streaming thread rather than the audio thread,
+    except while the process's memory is locked, when a mapping would pin the
+    whole file in RAM.
+
+    The streaming thread opens a zone's reader when it first needs it and
+    keeps the most recently used ones open, up to maxOpenReaders, so a large
+    library never holds a file handle or mapping for every zone.
+
+    Which heads are resident is up to the SampleCache, which keeps them under
+    a byte budget.
+
+    Zones are mixed down to mono as they're read, because every voice renders
+    into a mono lane.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#if JUCE_LINUX
+ #include <sys/mman.h>
+#endif
+
+//==============================================================================
+class SampleLibrary;
+
+struct SampleZone
+{
+    SampleLibrary* library = nullptr;
+    juce::File file;
+    int rootNote = 60, lowNote = 0, highNote = 127;
+    double sampleRate = 44100.0;
+    juce::int64 lengthInSamples = 0;
+
+    juce::AudioBuffer<float> head;       // the first headLength frames, once headLoaded is set
+    int headLength = 0;
+    std::atomic<bool> headLoaded { false };
+
+    std::atomic<int> playCount { 0 };             // voices playing it, which pins the head
+    std::atomic<juce::uint32> lastUsed { 0 };
+
+    size_t getHeadBytes() const noexcept          { return sizeof (float) * (size_t) headLength; }
+};
+
+//==============================================================================
+class SampleLibrary
+{
+public:
+    static constexpr int headFrames = 32768;
+
+    // Reads the headers of every WAV and FLAC file in the folder. Each file's
+    // root note comes from the end of its name, e.g. "Piano_C4.wav" or
+    // "Piano_060.flac", and each zone reaches halfway to its neighbours.
+    static std::shared_ptr<SampleLibrary> loadFolder (const juce::File& folder)
+    {
+        auto library = std::make_shared<SampleLibrary>();
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        for (auto& file : folder.findChildFiles (juce::File::findFiles, false, "*.wav;*.flac"))
+        {
+            auto zone = std::make_unique<SampleZone>();
+            zone->library = library.get();
+            zone->file = file;
+            zone->rootNote = parseRootNote (file.getFileNameWithoutExtension());
+
+            // Only the header is needed here; the reader closes the file as it goes.
+            std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (file));
+
+            if (reader == nullptr || reader->lengthInSamples <= 0)
+                continue;
+
+            zone->sampleRate = reader->sampleRate;
+            zone->lengthInSamples = reader->lengthInSamples;
+            zone->headLength = (int) juce::jmin ((juce::int64) headFrames, zone->lengthInSamples);
+            library->zones.add (zone.release());
+        }
+
+        std::sort (library->zones.begin(), library->zones.end(),
+                   [] (const SampleZone* a, const SampleZone* b) { return a->rootNote < b->rootNote; });
+
+        for (int i = 0; i < library->zones.size(); ++i)
+        {
+            auto* zone = library->zones.getUnchecked (i);
+            zone->lowNote  = i == 0 ? 0 : library->zones[i - 1]->highNote + 1;
+            zone->highNote = i == library->zones.size() - 1 ? 127
+                                                            : (zone->rootNote + library->zones[i + 1]->rootNote) / 2;
+        }
+
+        return library;
+    }
+
+    SampleZone* findZone (int midiNoteNumber) const noexcept
+    {
+        for (auto* zone : zones)
+            if (midiNoteNumber >= zone->lowNote && midiNoteNumber <= zone->highNote)
+                return zone;
+
+        return nullptr;
+    }
+
+    const juce::OwnedArray<SampleZone>& getZones() const noexcept    { return zones; }
+    bool isEmpty() const noexcept                                     { return zones.isEmpty(); }
+
+private:
+    static int parseRootNote (const juce::String& name)
+    {
+        auto token = juce::StringArray::fromTokens (name, "_- .", {}).strings.getLast().trim();
+
+        if (token.containsOnly ("0123456789"))
+            return juce::jlimit (0, 127, token.getIntValue());
+
+        static const char* const names[] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+
+        for (int n = 11; n >= 0; --n)
+        {
+            if (token.startsWithIgnoreCase (names[n]))
+            {
+                auto octave = token.substring ((int) std::strlen (names[n]));
+
+                if (octave.isNotEmpty() && octave.containsOnly ("-0123456789"))
+                    return juce::jlimit (0, 127, (octave.getIntValue() + 1) * 12 + n);
+            }
+        }
+
+        return 60;
+    }
+
+    juce::OwnedArray<SampleZone> zones;
+};
+
+//==============================================================================
+// Decides which zones' heads are resident. Heads for notes that are about to
+// play, and for the zones either side of them, are loaded first, evicting the
+// least recently played zones if they don't fit in the budget. Spare budget
+// is then filled with the rest of the current library's heads, without
+// evicting anything. A zone that a voice is playing is never evicted.
+class SampleCache
+{
+public:
+    struct Stats
+    {
+        juce::uint64 headHits = 0, headMisses = 0;
+        juce::uint64 residentBytes = 0, budgetBytes = 0, evictions = 0, prefetches = 0;
+        double meanPrefetchMs = 0.0, maxPrefetchMs = 0.0;
+    };
+
+    SampleCache() = default;
+
+    void setBudget (size_t newBudgetBytes)    { budgetBytes = newBudgetBytes; }
+
+    Stats getStats() const noexcept
+    {
+        Stats s;
+        s.headHits = headHits.load();
+        s.headMisses = headMisses.load();
+        s.residentBytes = residentBytes.load();
+        s.budgetBytes = budgetBytes.load();
+        s.evictions = evictions.load();
+        s.prefetches = prefetches.load();
+
+        auto numTimed = numPrefetchLoads.load();
+        s.meanPrefetchMs = numTimed > 0 ? juce::Time::highResolutionTicksToSeconds (totalPrefetchTicks.load()) * 1000.0 / (double) numTimed : 0.0;
+        s.maxPrefetchMs = juce::Time::highResolutionTicksToSeconds (maxPrefetchTicks.load()) * 1000.0;
+        return s;
+    }
+
+    //==============================================================================
+    // Audio thread. A voice holds on to a zone from note-on until it stops, and
+    // may only use the head if this returned true.
+    bool acquire (SampleZone& zone) noexcept
+    {
+        // The count goes up before headLoaded is checked, and eviction clears
+        // headLoaded before checking the count, so they can't both miss each other.
+        zone.playCount.fetch_add (1);
+        zone.lastUsed = ++useCounter;
+
+        auto resident = zone.headLoaded.load();
+        ++(resident ? headHits : headMisses);
+        return resident;
+    }
+
+    void release (SampleZone& zone) noexcept
+    {
+        zone.playCount.fetch_sub (1);
+    }
+
+    // Audio thread. Asks for the heads around a note that's about to play.
+    void prefetch (int midiNoteNumber) noexcept
+    {
+        const auto scope = requests.write (1);
+
+        if (scope.blockSize1 > 0)
+            requestQueue[(size_t) scope.startIndex1] = { midiNoteNumber, juce::Time::getHighResolutionTicks() };
+    }
+
+    //==============================================================================
+    // Streaming thread. loadHead (zone) must fill in the zone's head and set
+    // headLoaded. Returns true if it loaded anything.
+    template <typename LoadFunction>
+    bool service (const juce::Array<std::shared_ptr<SampleLibrary>>& libraries, SampleLibrary* current,
+                  LoadFunction&& loadHead)
+    {
+        auto didWork = false;
+
+        while (requests.getNumReady() > 0)
+        {
+            PrefetchRequest request;
+
+            {
+                const auto scope = requests.read (1);
+                request = requestQueue[(size_t) scope.startIndex1];
+            }
+
+            auto* zone = current != nullptr ? current->findZone (request.note) : nullptr;
+
+            if (zone == nullptr)
+                continue;
+
+            ++prefetches;
+            auto& zones = current->getZones();
+            auto index = zones.indexOf (zone);
+
+            if (makeResident (*zone, libraries, loadHead))
+            {
+                recordPrefetchTime (juce::Time::getHighResolutionTicks() - request.ticks);
+                didWork = true;
+            }
+
+            for (auto* neighbour : { zones[index - 1], zones[index + 1] })
+                if (neighbour != nullptr)
+                    didWork = makeResident (*neighbour, libraries, loadHead) || didWork;
+        }
+
+        if (didWork || current == nullptr)
+            return didWork;
+
+        for (auto* zone : current->getZones())
+        {
+            if (! zone->headLoaded.load() && residentBytes + zone->getHeadBytes() <= budgetBytes)
+            {
+                load (*zone, loadHead);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Streaming thread, before a library is dropped.
+    void forget (SampleLibrary& library)
+    {
+        for (auto* zone : library.getZones())
+            if (zone->headLoaded.load())
+                residentBytes -= zone->getHeadBytes();
+    }
+
+private:
+    //==============================================================================
+    struct PrefetchRequest
+    {
+        int note = 0;
+        juce::int64 ticks = 0;
+    };
+
+    static constexpr int maxPendingRequests = 256;
+
+    template <typename LoadFunction>
+    bool makeResident (SampleZone& zone, const juce::Array<std::shared_ptr<SampleLibrary>>& libraries,
+                       LoadFunction&& loadHead)
+    {
+        if (zone.headLoaded.load())
+        {
+            zone.lastUsed = ++useCounter;
+            return false;
+        }
+
+        while (residentBytes + zone.getHeadBytes() > budgetBytes)
+        {
+            auto* victim = findLeastRecentlyUsed (libraries);
+
+            if (victim == nullptr)
+                return false;
+
+            evict (*victim);
+        }
+
+        load (zone, loadHead);
+        zone.lastUsed = ++useCounter;
+        return true;
+    }
+
+    template <typename LoadFunction>
+    void load (SampleZone& zone, LoadFunction&& loadHead)
+    {
+        loadHead (zone);
+        residentBytes += zone.getHeadBytes();
+    }
+
+    SampleZone* findLeastRecentlyUsed (const juce::Array<std::shared_ptr<SampleLibrary>>& libraries) const
+    {
+        SampleZone* oldest = nullptr;
+
+        for (auto& library : libraries)
+            for (auto* zone : library->getZones())
+                if (zone->headLoaded.load() && zone->playCount.load() == 0
+                     && (oldest == nullptr || zone->lastUsed.load() < oldest->lastUsed.load()))
+                    oldest = zone;
+
+        return oldest;
+    }
+
+    void evict (SampleZone& zone)
+    {
+        zone.headLoaded.store (false);
+
+        // A voice started on it in the meantime, so leave it where it is.
+        if (zone.playCount.load() > 0)
+        {
+            zone.headLoaded.store (true);
+            zone.lastUsed = ++useCounter;
+            return;
+        }
+
+        zone.head = juce::AudioBuffer<float>();
+        residentBytes -= zone.getHeadBytes();
+        ++evictions;
+    }
+
+    void recordPrefetchTime (juce::int64 ticks)
+    {
+        totalPrefetchTicks += ticks;
+        ++numPrefetchLoads;
+
+        if (ticks > maxPrefetchTicks)
+            maxPrefetchTicks = ticks;
+    }
+
+    //==============================================================================
+    juce::AbstractFifo requests { maxPendingRequests };
+    std::array<PrefetchRequest, (size_t) maxPendingRequests> requestQueue;
+
+    std::atomic<size_t> budgetBytes { (size_t) 256 * 1024 * 1024 }, residentBytes { 0 };
+    std::atomic<juce::uint32> useCounter { 0 };
+    std::atomic<juce::uint64> headHits { 0 }, headMisses { 0 }, evictions { 0 }, prefetches { 0 }, numPrefetchLoads { 0 };
+    std::atomic<juce::int64> totalPrefetchTicks { 0 }, maxPrefetchTicks { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleCache)
+};
+
+//==============================================================================
+class SampleStreamer   : private juce::Thread
+{
+    struct Stream;
+
+public:
+    static constexpr int ringFrames = 32768, readChunkFrames = 4096, maxOpenReaders = 64;
+
+    struct Stats   : public SampleCache::Stats
+    {
+        juce::uint64 underruns = 0, framesStreamed = 0, readersOpened = 0;
+
+        double getHeadHitRate() const noexcept
+        {
+            auto total = headHits + headMisses;
+            return total > 0 ? (double) headHits / (double) total : 1.0;
+        }
+    };
+
+    explicit SampleStreamer (int numStreams)
+        : juce::Thread ("Sample streamer")
+    {
+        for (int i = 0; i < numStreams; ++i)
+            streams.add (new Stream());
+
+        readBuffer.setSize (2, readChunkFrames);
+    }
+
+    ~SampleStreamer() override
+    {
+        stopThread (2000);
+    }
+
+    void setMemoryBudget (size_t bytes)           { cache.setBudget (bytes); }
+
+    // Set before the process's memory is locked, and before a library is
+    // loaded, as readers already open keep their mappings. Files are then read
+    // rather than mapped, and each head is locked as it's loaded, since only
+    // the pages that existed at the time are.
+    void setMemoryLocked (bool isLocked) noexcept { memoryLocked = isLocked; }
+
+    // Audio thread: a note-on for this note is about to be rendered.
+    void prefetch (int midiNoteNumber) noexcept   { cache.prefetch (midiNoteNumber); }
+
+    // Makes this the library whose heads get preloaded. Libraries that notes
+    // are still streaming from stay alive until those notes have stopped.
+    void setLibrary (std::shared_ptr<SampleLibrary> newLibrary)
+    {
+        {
+            const juce::ScopedLock sl (libraryLock);
+            libraries.add (newLibrary);
+            currentLibrary = newLibrary.get();
+        }
+
+        if (! isThreadRunning())
+            startThread (8);
+    }
+
+    Stats getStats() const noexcept
+    {
+        Stats s;
+        static_cast<SampleCache::Stats&> (s) = cache.getStats();
+        s.underruns = underruns.load();
+        s.framesStreamed = framesStreamed.load();
+        s.readersOpened = readersOpened.load();
+        return s;
+    }
+
+    //==============================================================================
+    // The audio thread's side of one stream, used by a single voice.
+    class Reader
+    {
+    public:
+        Reader (SampleStreamer& s, int index) : streamer (s), stream (*s.streams[index]) {}
+
+        // Starts streaming a zone. If its head is resident the stream picks up
+        // where the head ends and this returns true, otherwise it starts from
+        // the beginning.
+        bool start (SampleZone* zone)
+        {
+            if (currentZone != nullptr)
+                streamer.cache.release (*currentZone);
+
+            currentZone = zone;
+            auto headResident = streamer.cache.acquire (*zone);
+
+            stream.requestedZone.store (zone, std::memory_order_relaxed);
+            stream.requestedStart.store (headResident ? zone->headLength : 0, std::memory_order_relaxed);
+            generation = stream.requestedGeneration.fetch_add (1, std::memory_order_release) + 1;
+            framesToSkip = 0;
+
+            return headResident;
+        }
+
+        void stop()
+        {
+            if (currentZone != nullptr)
+                streamer.cache.release (*currentZone);
+
+            currentZone = nullptr;
+            stream.requestedZone.store (nullptr, std::memory_order_relaxed);
+            generation = stream.requestedGeneration.fetch_add (1, std::memory_order_release) + 1;
+        }
+
+        // Reads the next numFrames streamed frames. Any that haven't arrived are
+        // zeroed, counted as an underrun and skipped when they do arrive, so the
+        // stream stays in step with the voice.
+        void read (float* dest, int numFrames) noexcept
+        {
+            auto ready = stream.readyGeneration.load (std::memory_order_acquire) == generation;
+            auto available = ready ? stream.fifo.getNumReady() : 0;
+
+            if (framesToSkip > 0 && available > 0)
+            {
+                auto skipped = juce::jmin (framesToSkip, available);
+                stream.fifo.finishedRead (skipped);
+                framesToSkip -= skipped;
+                available -= skipped;
+            }
+
+            auto numToRead = juce::jmin (numFrames, available);
+
+            if (numToRead > 0)
+            {
+                const auto scope = stream.fifo.read (numToRead);
+                auto* ring = stream.ring.getReadPointer (0);
+
+                std::copy (ring + scope.startIndex1, ring + scope.startIndex1 + scope.blockSize1, dest);
+                std::copy (ring + scope.startIndex2, ring + scope.startIndex2 + scope.blockSize2, dest + scope.blockSize1);
+            }
+
+            if (numToRead < numFrames)
+            {
+                std::fill (dest + numToRead, dest + numFrames, 0.0f);
+                framesToSkip += numFrames - numToRead;
+                ++streamer.underruns;
+            }
+        }
+
+    private:
+        SampleStreamer& streamer;
+        Stream& stream;
+        SampleZone* currentZone = nullptr;
+        juce::uint32 generation = 0;
+        int framesToSkip = 0;
+    };
+
+private:
+    //==============================================================================
+    struct Stream
+    {
+        Stream()
+        {
+            ring.setSize (1, ringFrames);
+        }
+
+        juce::AbstractFifo fifo { ringFrames };
+        juce::AudioBuffer<float> ring;
+
+        std::atomic<SampleZone*> requestedZone { nullptr };
+        std::atomic<juce::int64> requestedStart { 0 };
+        std::atomic<juce::uint32> requestedGeneration { 0 }, readyGeneration { 0 };
+
+        // Only touched by the streaming thread.
+        SampleZone* zone = nullptr;
+        juce::int64 readPosition = 0;
+        juce::uint32 activeGeneration = 0;
+    };
+
+    // A zone's open file, owned by the streaming thread.
+    struct OpenReader
+    {
+        SampleZone* zone = nullptr;
+        std::unique_ptr<juce::AudioFormatReader> reader;
+        juce::uint32 lastUsed = 0;
+    };
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            auto didWork = false;
+
+            for (auto* stream : streams)
+                didWork = serviceStream (*stream) || didWork;
+
+            {
+                const juce::ScopedLock sl (libraryLock);
+                didWork = cache.service (libraries, currentLibrary, [this] (SampleZone& zone) { loadHead (zone); }) || didWork;
+            }
+
+            if (! didWork)
+            {
+                releaseUnusedLibraries();
+                wait (1);
+            }
+        }
+    }
+
+    bool serviceStream (Stream& stream)
+    {
+        auto requested = stream.requestedGeneration.load (std::memory_order_acquire);
+
+        if (requested != stream.activeGeneration)
+        {
+            stream.fifo.reset();
+            stream.activeGeneration = requested;
+            stream.zone = stream.requestedZone.load (std::memory_order_relaxed);
+            stream.readPosition = stream.requestedStart.load (std::memory_order_relaxed);
+            stream.readyGeneration.store (requested, std::memory_order_release);
+        }
+
+        auto* zone = stream.zone;
+
+        if (zone == nullptr || stream.readPosition >= zone->lengthInSamples)
+            return false;
+
+        auto numFrames = (int) juce::jmin ((juce::int64) juce::jmin (readChunkFrames, stream.fifo.getFreeSpace()),
+                                           zone->lengthInSamples - stream.readPosition);
+
+        if (numFrames < readChunkFrames / 2 && stream.readPosition + numFrames < zone->lengthInSamples)
+            return false;
+
+        readMono (*zone, stream.readPosition, numFrames);
+
+        const auto scope = stream.fifo.write (numFrames);
+        auto* ring = stream.ring.getWritePointer (0);
+        auto* src = readBuffer.getReadPointer (0);
+
+        std::copy (src, src + scope.blockSize1, ring + scope.startIndex1);
+        std::copy (src + scope.blockSize1, src + scope.blockSize1 + scope.blockSize2, ring + scope.startIndex2);
+
+        stream.readPosition += numFrames;
+        framesStreamed += (juce::uint64) numFrames;
+        return true;
+    }
+
+    // Reads frames into channel 0 of readBuffer, mixed down to mono.
+    void readMono (SampleZone& zone, juce::int64 start, int numFrames)
+    {
+        auto* reader = getReader (zone);
+
+        if (reader == nullptr)
+        {
+            readBuffer.clear (0, 0, numFrames);
+            return;
+        }
+
+        auto numChannels = (int) juce::jmin (2u, reader->numChannels);
+        reader->read (&readBuffer, 0, numFrames, start, true, numChannels > 1);
+
+        if (numChannels > 1)
+        {
+            readBuffer.addFrom (0, 0, readBuffer, 1, 0, numFrames);
+            readBuffer.applyGain (0, 0, numFrames, 0.5f);
+        }
+    }
+
+    // The zone's reader, opened if it isn't already. When maxOpenReaders are
+    // open, the least recently used one is closed to make room.
+    juce::AudioFormatReader* getReader (SampleZone& zone)
+    {
+        OpenReader* slot = nullptr;
+
+        for (auto& open : openReaders)
+        {
+            if (open.zone == &zone)
+            {
+                open.lastUsed = ++readerUseCounter;
+                return open.reader.get();
+            }
+
+            if (slot == nullptr || open.lastUsed < slot->lastUsed)
+                slot = &open;
+        }
+
+        if (openReaders.size() < (size_t) maxOpenReaders)
+        {
+            openReaders.emplace_back();
+            slot = &openReaders.back();
+        }
+
+        slot->zone = &zone;
+        slot->reader = openReader (zone.file);
+        slot->lastUsed = ++readerUseCounter;
+        ++readersOpened;
+        return slot->reader.get();
+    }
+
+    std::unique_ptr<juce::AudioFormatReader> openReader (const juce::File& file) const
+    {
+        if (file.hasFileExtension ("wav"))
+        {
+            if (! memoryLocked)
+            {
+                std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped (juce::WavAudioFormat().createMemoryMappedReader (file));
+
+                if (mapped != nullptr && mapped->mapEntireFile())
+                    return std::move (mapped);
+            }
+
+            // With memory locked, or without the address space to map it, read the file.
+            return std::unique_ptr<juce::AudioFormatReader> (juce::WavAudioFormat().createReaderFor (file.createInputStream().release(), true));
+        }
+
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+        return std::unique_ptr<juce::AudioFormatReader> (formats.createReaderFor (file));
+    }
+
+    void closeReaders (const SampleLibrary& library)
+    {
+        openReaders.erase (std::remove_if (openReaders.begin(), openReaders.end(),
+                                           [&library] (const OpenReader& open) { return open.zone->library == &library; }),
+                           openReaders.end());
+    }
+
+    void loadHead (SampleZone& zone)
+    {
+        juce::AudioBuffer<float> head (1, juce::jmax (1, zone.headLength));
+
+        for (int done = 0; done < zone.headLength; done += readChunkFrames)
+        {
+            auto n = juce::jmin (readChunkFrames, zone.headLength - done);
+            readMono (zone, done, n);
+            head.copyFrom (0, done, readBuffer, 0, 0, n);
+        }
+
+        zone.head = std::move (head);
+
+       #if JUCE_LINUX
+        if (memoryLocked)
+            mlock (zone.head.getReadPointer (0), zone.getHeadBytes());   // best effort, as with mlockall
+       #endif
+
+        zone.headLoaded.store (true);
+    }
+
+    void releaseUnusedLibraries()
+    {
+        const juce::ScopedLock sl (libraryLock);
+
+        for (int i = libraries.size(); --i >= 0;)
+        {
+            auto* library = libraries.getReference (i).get();
+
+            if (library == currentLibrary)
+                continue;
+
+            auto inUse = std::any_of (streams.begin(), streams.end(), [library] (Stream* s)
+            {
+                auto* requested = s->requestedZone.load();
+                return (s->zone != nullptr && s->zone->library == library)
+                        || (requested != nullptr && requested->library == library);
+            });
+
+            if (! inUse)
+            {
+                cache.forget (*library);
+                closeReaders (*library);
+                libraries.remove (i);
+            }
+        }
+    }
+
+    //==============================================================================
+    juce::OwnedArray<Stream> streams;
+    juce::AudioBuffer<float> readBuffer;
+
+    std::vector<OpenReader> openReaders;
+    juce::uint32 readerUseCounter = 0;
+    std::atomic<bool> memoryLocked { false };
+
+    juce::CriticalSection libraryLock;
+    juce::Array<std::shared_ptr<SampleLibrary>> libraries;
+    SampleLibrary* currentLibrary = nullptr;
+
+    SampleCache cache;
+    std::atomic<juce::uint64> underruns { 0 }, framesStreamed { 0 }, readersOpened { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleStreamer)
+};
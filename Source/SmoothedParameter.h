@@ -0,0 +1,207 @@
+/*
+  ==============================================================================
+
+    A parameter that moves to each new value over a ramp instead of jumping,
+    so that changing it while notes sound doesn't zipper.
+
+    The target can be set from any thread. Once per block the audio thread
+    calls beginBlock(), which works out the whole block's values in one go
+    into a buffer that every voice reading the parameter then shares. Each
+    ramp shape is evaluated in closed form, as a straight line or as a
+    geometric series built up a row of eight at a time, so the loops have no
+    per-sample branches and vectorise.
+
+    Outside a ramp nothing is computed and getRamp() returns nullptr; readers
+    then use getValue(), which is exactly the last target given.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+class SmoothedParameter
+{
+public:
+    enum class Ramp
+    {
+        linear,         // a straight line, over the ramp length
+        exponential,    // a constant ratio per sample, over the ramp length; for values that don't cross zero
+        onePole         // a one-pole lowpass with the ramp length as its time constant, settled after seven of them
+    };
+
+    SmoothedParameter (Ramp rampToUse, double rampLengthSeconds, double initialValue)
+        : shape (rampToUse), rampSeconds (rampLengthSeconds),
+          target (initialValue), current (initialValue), lastTarget (initialValue)
+    {
+    }
+
+    // Allocates room for blocks of up to maxBlockSize samples. Nothing grows
+    // on the audio thread, so blocks must never be longer.
+    void prepare (int maxBlockSize)
+    {
+        capacity = roundUpToRow (maxBlockSize);
+        values.allocate ((size_t) capacity, true);
+    }
+
+    // The rate that ramps are worked out at. A ramp in progress carries on at
+    // the new rate from where it is.
+    void setSampleRate (double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+
+        if (remaining > 0)
+            startRamp (lastTarget);
+    }
+
+    // Any thread.
+    void setTarget (double newTarget) noexcept
+    {
+        target.store (newTarget, std::memory_order_relaxed);
+    }
+
+    // Jumps straight to a value, abandoning any ramp. Audio thread, or while
+    // it isn't running.
+    void setCurrentAndTarget (double newValue) noexcept
+    {
+        target.store (newValue, std::memory_order_relaxed);
+        current = lastTarget = newValue;
+        remaining = 0;
+        smoothing = false;
+    }
+
+    //==============================================================================
+    // Audio thread, once per block, before anything reads the parameter.
+    void beginBlock (int numSamples) noexcept
+    {
+        auto newTarget = target.load (std::memory_order_relaxed);
+
+        if (newTarget != lastTarget)
+            startRamp (newTarget);
+
+        smoothing = remaining > 0;
+
+        if (! smoothing)
+            return;
+
+        jassert (numSamples <= capacity);
+
+        auto numRamped = juce::jmin (numSamples, remaining);
+        auto* dest = values.get();
+
+        switch (activeRamp)
+        {
+            case Ramp::linear:       fillLine (dest, numRamped, current, step); break;
+            case Ramp::exponential:  fillGeometric (dest, numRamped, 0.0, current, step); break;
+            case Ramp::onePole:      fillGeometric (dest, numRamped, lastTarget, current - lastTarget, step); break;
+        }
+
+        std::fill (dest + numRamped, dest + numSamples, (float) lastTarget);
+
+        remaining -= numRamped;
+
+        if (remaining == 0)
+            current = lastTarget;
+        else if (activeRamp == Ramp::linear)
+            current += step * numRamped;
+        else if (activeRamp == Ramp::exponential)
+            current *= std::pow (step, (double) numRamped);
+        else
+            current = lastTarget + (current - lastTarget) * std::pow (step, (double) numRamped);
+    }
+
+    // Whether this block is ramping.
+    bool isSmoothing() const noexcept       { return smoothing; }
+
+    // This block's values, one per sample, or nullptr when it isn't ramping.
+    const float* getRamp() const noexcept   { return smoothing ? values.get() : nullptr; }
+
+    // The value at the end of this block.
+    double getValue() const noexcept        { return current; }
+
+    double getTarget() const noexcept       { return target.load (std::memory_order_relaxed); }
+
+private:
+    static constexpr int rowSize = 8;
+
+    static int roundUpToRow (int n) noexcept    { return (n + rowSize - 1) / rowSize * rowSize; }
+
+    void startRamp (double newTarget) noexcept
+    {
+        lastTarget = newTarget;
+        auto length = juce::jmax (1.0, std::ceil (rampSeconds * sampleRate));
+
+        if (sampleRate <= 0.0 || current == newTarget)
+        {
+            current = newTarget;
+            remaining = 0;
+            return;
+        }
+
+        // No ratio gets across zero, so such a ramp goes in a straight line.
+        activeRamp = shape == Ramp::exponential && current * newTarget <= 0.0 ? Ramp::linear : shape;
+
+        switch (activeRamp)
+        {
+            case Ramp::linear:
+                remaining = (int) length;
+                step = (newTarget - current) / length;
+                break;
+
+            case Ramp::exponential:
+                remaining = (int) length;
+                step = std::pow (newTarget / current, 1.0 / length);
+                break;
+
+            case Ramp::onePole:
+                remaining = (int) std::ceil (length * std::log (1000.0));
+                step = std::exp (-1.0 / length);
+                break;
+        }
+    }
+
+    // dest[i] = start + increment * (i + 1)
+    static void fillLine (float* dest, int numSamples, double start, double increment) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = (float) (start + increment * (double) (i + 1));
+    }
+
+    // dest[i] = offset + scale * ratio^(i + 1), a row of eight at a time. The
+    // row is kept in double so that long ramps don't drift.
+    static void fillGeometric (float* dest, int numSamples, double offset, double scale, double ratio) noexcept
+    {
+        double row[rowSize];
+        auto term = scale;
+
+        for (auto& r : row)
+            r = term *= ratio;
+
+        auto rowStep = std::pow (ratio, (double) rowSize);
+
+        for (int start = 0; start < numSamples; start += rowSize)
+        {
+            for (int i = 0; i < rowSize; ++i)
+            {
+                dest[start + i] = (float) (offset + row[i]);
+                row[i] *= rowStep;
+            }
+        }
+    }
+
+    //==============================================================================
+    const Ramp shape;
+    Ramp activeRamp = shape;
+    const double rampSeconds;
+    double sampleRate = 0.0;
+
+    std::atomic<double> target;
+    double current, lastTarget, step = 0.0;
+    int remaining = 0;
+    bool smoothing = false;
+
+    juce::HeapBlock<float> values;
+    int capacity = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (SmoothedParameter)
+};
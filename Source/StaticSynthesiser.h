@@ -0,0 +1,381 @@
+/*
+  ==============================================================================
+
+    A synthesiser whose voice and sound types are fixed at compile time.
+
+    juce::Synthesiser reaches every voice through SynthesiserVoice's virtual
+    functions and matches sounds with canPlaySound(). Here the voice type is
+    final, so renderStatic() is inlined into the mixing loop, the channel count
+    is a template argument, and only VoiceType::SoundType can be added.
+
+    Note allocation and voice stealing follow juce::Synthesiser exactly, so
+    both produce the same output for the same MIDI.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+template <int numChannels>
+struct StaticChannelMix
+{
+    static forcedinline void mix (float* const* channels, int startSample, const float* source, int numSamples) noexcept
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* d = channels[ch] + startSample;
+
+            for (int i = 0; i < numSamples; ++i)
+                d[i] += source[i];
+        }
+    }
+};
+
+template <>
+struct StaticChannelMix<1>
+{
+    static forcedinline void mix (float* const* channels, int startSample, const float* source, int numSamples) noexcept
+    {
+        auto* d = channels[0] + startSample;
+
+        for (int i = 0; i < numSamples; ++i)
+            d[i] += source[i];
+    }
+};
+
+template <>
+struct StaticChannelMix<2>
+{
+    static forcedinline void mix (float* const* channels, int startSample, const float* source, int numSamples) noexcept
+    {
+        auto* l = channels[0] + startSample;
+        auto* r = channels[1] + startSample;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            l[i] += source[i];
+            r[i] += source[i];
+        }
+    }
+};
+
+//==============================================================================
+template <typename VoiceType, int numOutputChannels>
+class StaticSynthesiser
+{
+public:
+    using SoundType = typename VoiceType::SoundType;
+
+    static_assert (std::is_final<VoiceType>::value, "The voice type must be final so that its calls can be devirtualised");
+    static_assert (std::is_final<SoundType>::value, "The sound type must be final so that its calls can be devirtualised");
+    static_assert (numOutputChannels > 0, "");
+
+    static constexpr int numChannels = numOutputChannels;
+
+    //==============================================================================
+    explicit StaticSynthesiser (int numVoices)
+    {
+        for (int i = 0; i < numVoices; ++i)
+            voices.add (new VoiceType());
+
+        slots.resize ((size_t) numVoices);
+    }
+
+    int getNumVoices() const noexcept                { return voices.size(); }
+    VoiceType* getVoice (int index) const noexcept   { return voices[index]; }
+
+    void addSound (SoundType* newSound)              { sounds.add (newSound); }
+    void clearSounds()                               { sounds.clear(); }
+
+    void setCurrentPlaybackSampleRate (double newRate)
+    {
+        if (sampleRate != newRate)
+        {
+            allNotesOff (0, false);
+            sampleRate = newRate;
+
+            for (auto* voice : voices)
+                voice->setCurrentPlaybackSampleRate (newRate);
+        }
+    }
+
+    //==============================================================================
+    // Same sub-block splitting as juce::Synthesiser with a 32 sample minimum
+    // and non-strict subdivision.
+    void renderNextBlock (juce::AudioBuffer<float>& outputAudio, const juce::MidiBuffer& midiData,
+                          int startSample, int numSamples)
+    {
+        jassert (sampleRate != 0);
+        jassert (outputAudio.getNumChannels() >= numChannels);
+
+        auto midiIterator = midiData.findNextSamplePosition (startSample);
+        auto* channels = outputAudio.getArrayOfWritePointers();
+        bool firstEvent = true;
+
+        for (; numSamples > 0; ++midiIterator)
+        {
+            if (midiIterator == midiData.cend())
+            {
+                renderVoices (channels, startSample, numSamples);
+                return;
+            }
+
+            const auto metadata = *midiIterator;
+            const int samplesToNextMidiMessage = metadata.samplePosition - startSample;
+
+            if (samplesToNextMidiMessage >= numSamples)
+            {
+                renderVoices (channels, startSample, numSamples);
+                handleMidiEvent (metadata.getMessage());
+                break;
+            }
+
+            if (samplesToNextMidiMessage < (firstEvent ? 1 : minimumSubBlockSize))
+            {
+                handleMidiEvent (metadata.getMessage());
+                continue;
+            }
+
+            firstEvent = false;
+
+            renderVoices (channels, startSample, samplesToNextMidiMessage);
+            handleMidiEvent (metadata.getMessage());
+            startSample += samplesToNextMidiMessage;
+            numSamples  -= samplesToNextMidiMessage;
+        }
+
+        std::for_each (midiIterator, midiData.cend(),
+                       [&] (const juce::MidiMessageMetadata& meta) { handleMidiEvent (meta.getMessage()); });
+    }
+
+    //==============================================================================
+    void noteOn (int midiChannel, int midiNoteNumber, float velocity)
+    {
+        for (auto* sound : sounds)
+        {
+            if (sound->SoundType::appliesToNote (midiNoteNumber) && sound->SoundType::appliesToChannel (midiChannel))
+            {
+                for (int i = 0; i < voices.size(); ++i)
+                    if (getPlayingNote (i) == midiNoteNumber && slots[(size_t) i].channel == midiChannel)
+                        stopVoice (i, 1.0f, true);
+
+                startVoice (findFreeVoice (midiNoteNumber), sound, midiChannel, midiNoteNumber, velocity);
+            }
+        }
+    }
+
+    void noteOff (int midiChannel, int midiNoteNumber, float velocity)
+    {
+        for (int i = 0; i < voices.size(); ++i)
+        {
+            auto& slot = slots[(size_t) i];
+
+            if (getPlayingNote (i) == midiNoteNumber && slot.channel == midiChannel
+                 && slot.sound->SoundType::appliesToNote (midiNoteNumber)
+                 && slot.sound->SoundType::appliesToChannel (midiChannel))
+            {
+                slot.keyDown = false;
+
+                if (! slot.sustainPedalDown)
+                    stopVoice (i, velocity, true);
+            }
+        }
+    }
+
+    void allNotesOff (int midiChannel, bool allowTailOff)
+    {
+        for (int i = 0; i < voices.size(); ++i)
+            if (midiChannel <= 0 || slots[(size_t) i].channel == midiChannel)
+                stopVoice (i, 1.0f, allowTailOff);
+
+        sustainPedalsDown.clear();
+    }
+
+    void handleSustainPedal (int midiChannel, bool isDown)
+    {
+        jassert (midiChannel > 0 && midiChannel <= 16);
+
+        if (isDown)
+        {
+            sustainPedalsDown.setBit (midiChannel);
+
+            for (int i = 0; i < voices.size(); ++i)
+                if (isActive (i) && slots[(size_t) i].channel == midiChannel && slots[(size_t) i].keyDown)
+                    slots[(size_t) i].sustainPedalDown = true;
+        }
+        else
+        {
+            for (int i = 0; i < voices.size(); ++i)
+            {
+                auto& slot = slots[(size_t) i];
+
+                if (isActive (i) && slot.channel == midiChannel)
+                {
+                    slot.sustainPedalDown = false;
+
+                    if (! slot.keyDown)
+                        stopVoice (i, 1.0f, true);
+                }
+            }
+
+            sustainPedalsDown.clearBit (midiChannel);
+        }
+    }
+
+private:
+    //==============================================================================
+    struct VoiceSlot
+    {
+        SoundType* sound = nullptr;
+        int note = -1, channel = 0;
+        juce::uint32 noteOnTime = 0;
+        bool keyDown = false, sustainPedalDown = false;
+    };
+
+    static constexpr int minimumSubBlockSize = 32;
+
+    juce::OwnedArray<VoiceType> voices;
+    juce::ReferenceCountedArray<SoundType> sounds;
+    std::vector<VoiceSlot> slots;
+    juce::BigInteger sustainPedalsDown;
+    juce::uint32 lastNoteOnCounter = 0;
+    double sampleRate = 0;
+
+    //==============================================================================
+    // A voice that has finished its tail clears itself, so the slot only counts
+    // while the voice is still producing sound.
+    bool isActive (int index) const noexcept
+    {
+        return slots[(size_t) index].note >= 0 && voices.getUnchecked (index)->VoiceType::isSounding();
+    }
+
+    int getPlayingNote (int index) const noexcept
+    {
+        return isActive (index) ? slots[(size_t) index].note : -1;
+    }
+
+    bool isPlayingButReleased (int index) const noexcept
+    {
+        auto& slot = slots[(size_t) index];
+        return isActive (index) && ! (slot.keyDown || slot.sustainPedalDown);
+    }
+
+    forcedinline void renderVoices (float* const* channels, int startSample, int numSamples)
+    {
+        for (auto* voice : voices)
+            voice->template renderStatic<numChannels> (channels, startSample, numSamples);
+    }
+
+    void handleMidiEvent (const juce::MidiMessage& m)
+    {
+        auto channel = m.getChannel();
+
+        if (m.isNoteOn())
+            noteOn (channel, m.getNoteNumber(), m.getFloatVelocity());
+        else if (m.isNoteOff())
+            noteOff (channel, m.getNoteNumber(), m.getFloatVelocity());
+        else if (m.isAllNotesOff() || m.isAllSoundOff())
+            allNotesOff (channel, true);
+        else if (m.isSustainPedalOn())
+            handleSustainPedal (channel, true);
+        else if (m.isSustainPedalOff())
+            handleSustainPedal (channel, false);
+    }
+
+    //==============================================================================
+    void startVoice (int index, SoundType* sound, int midiChannel, int midiNoteNumber, float velocity)
+    {
+        if (index < 0)
+            return;
+
+        auto* voice = voices.getUnchecked (index);
+        auto& slot = slots[(size_t) index];
+
+        if (isActive (index))
+            voice->VoiceType::stopNote (0.0f, false);
+
+        slot.sound = sound;
+        slot.note = midiNoteNumber;
+        slot.channel = midiChannel;
+        slot.noteOnTime = ++lastNoteOnCounter;
+        slot.keyDown = true;
+        slot.sustainPedalDown = sustainPedalsDown[midiChannel];
+
+        voice->VoiceType::startNote (midiNoteNumber, velocity, sound, 0x2000);
+    }
+
+    void stopVoice (int index, float velocity, bool allowTailOff)
+    {
+        if (isActive (index))
+            voices.getUnchecked (index)->VoiceType::stopNote (velocity, allowTailOff);
+    }
+
+    int findFreeVoice (int midiNoteNumber) const
+    {
+        for (int i = 0; i < voices.size(); ++i)
+            if (! isActive (i))
+                return i;
+
+        return findVoiceToSteal (midiNoteNumber);
+    }
+
+    // The same heuristics as juce::Synthesiser::findVoiceToSteal(): re-use the
+    // oldest notes first, and protect the lowest and highest held notes.
+    int findVoiceToSteal (int midiNoteNumber) const
+    {
+        jassert (! voices.isEmpty());
+
+        int low = -1, top = -1;
+        juce::Array<int> usableVoices;
+        usableVoices.ensureStorageAllocated (voices.size());
+
+        for (int i = 0; i < voices.size(); ++i)
+        {
+            usableVoices.add (i);
+
+            if (! isPlayingButReleased (i))
+            {
+                auto note = getPlayingNote (i);
+
+                if (low < 0 || note < getPlayingNote (low))
+                    low = i;
+
+                if (top < 0 || note > getPlayingNote (top))
+                    top = i;
+            }
+        }
+
+        std::stable_sort (usableVoices.begin(), usableVoices.end(), [this] (int a, int b)
+        {
+            return slots[(size_t) a].noteOnTime < slots[(size_t) b].noteOnTime;
+        });
+
+        if (top == low)
+            top = -1;
+
+        for (auto i : usableVoices)
+            if (getPlayingNote (i) == midiNoteNumber)
+                return i;
+
+        for (auto i : usableVoices)
+            if (i != low && i != top && isPlayingButReleased (i))
+                return i;
+
+        for (auto i : usableVoices)
+            if (i != low && i != top && ! slots[(size_t) i].keyDown)
+                return i;
+
+        for (auto i : usableVoices)
+            if (i != low && i != top)
+                return i;
+
+        jassert (low >= 0);
+        return top >= 0 ? top : low;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StaticSynthesiser)
+};
+
+template <typename VoiceType> using MonoSynthesiser   = StaticSynthesiser<VoiceType, 1>;
+template <typename VoiceType> using StereoSynthesiser = StaticSynthesiser<VoiceType, 2>;
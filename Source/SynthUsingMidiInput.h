@@ -31,7 +31,7 @@
 
  dependencies:     juce_audio_basics, juce_audio_devices, juce_audio_formats,
                    juce_audio_processors, juce_audio_utils, juce_core,
-                   juce_data_structures, juce_events, juce_graphics,
+                   juce_data_structures, juce_dsp, juce_events, juce_graphics,
                    juce_gui_basics, juce_gui_extra
  exporters:        xcode_mac, vs2019, linux_make
 
@@ -47,49 +47,135 @@
 
 #pragma once
 
+#include "Trace.h"
+#include "RenderKernels.h"
+#include "SmoothedParameter.h"
+#include "NoteCurves.h"
+#include "StaticSynthesiser.h"
+#include "VoiceFilterBank.h"
+#include "MasterReverb.h"
+#include "FmVoiceBank.h"
+#include "SampleStreaming.h"
+#include "PartBank.h"
+#include "EnginePreset.h"
+#include "MidiInputMerger.h"
+#include "MidiDeviceWatcher.h"
+#include "KeyboardBridge.h"
+#include "RealtimeSetup.h"
+
+//==============================================================================
+// Every sound given to SynthAudioSource derives from this, so a voice can check
+// what it's been handed with a compare rather than a dynamic_cast.
+struct TypedSound   : public juce::SynthesiserSound
+{
+    enum class Kind
+    {
+        sineWave,
+        fm,
+        additive,
+        sampler
+    };
+
+    explicit TypedSound (Kind k) : kind (k) {}
+
+    // A sound that's been given a part bank only takes new notes on the
+    // channels of parts that have its slot selected, so switching a part's
+    // sound is a single store.
+    void setParts (const PartBank* bank, int slotIndex) noexcept
+    {
+        parts = bank;
+        slot = slotIndex;
+    }
+
+    bool isSelected (int midiChannel) const noexcept    { return parts == nullptr || parts->isSoundSelected (midiChannel, slot); }
+
+    const Kind kind;
+
+private:
+    const PartBank* parts = nullptr;
+    int slot = 0;
+};
+
+//==============================================================================
+// The tail-off while the decay is being smoothed: each sample's factor comes
+// from the shared ramp instead of state.decay. Returns the number of samples
+// written, which is fewer than numSamples if the note finishes.
+//
+// The envelope is a running product, so it's built first in a loop with no
+// branches, counting the samples still above the threshold as it goes (the
+// decays are all below 1, so those come first). The chunk is then scaled in
+// one vector multiply.
+inline int applyDecayRamp (float* samples, int numSamples, double gain,
+                           VoiceRenderState& state, const float* decays) noexcept
+{
+    jassert (numSamples <= RenderKernels::maxChunkSize);
+    alignas (64) float envelope[RenderKernels::maxChunkSize];
+
+    auto tailOff = state.tailOff;
+    int numAbove = 0;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        envelope[i] = (float) (gain * tailOff);
+        tailOff *= decays[i];
+        numAbove += tailOff > RenderKernelsDetail::tailOffThreshold ? 1 : 0;
+    }
+
+    // Once the note has finished the state only has to say so, so the product
+    // past the end of it is as good as the value where it crossed.
+    auto numRendered = juce::jmin (numSamples, numAbove + 1);
+    state.tailOff = tailOff;
+
+    juce::FloatVectorOperations::multiply (samples, envelope, numRendered);
+    return numRendered;
+}
+
 //==============================================================================
-struct SineWaveSound   : public juce::SynthesiserSound
+struct SineWaveSound final   : public TypedSound
 {
-    SineWaveSound() {}
+    SineWaveSound() : TypedSound (Kind::sineWave) {}
 
-    bool appliesToNote    (int) override        { return true; }
-    bool appliesToChannel (int) override        { return true; }
+    bool appliesToNote    (int) override                { return true; }
+    bool appliesToChannel (int midiChannel) override    { return isSelected (midiChannel); }
 };
 
 //==============================================================================
-struct SineWaveVoice   : public juce::SynthesiserVoice
+struct SineWaveVoice final   : public juce::SynthesiserVoice
 {
-    SineWaveVoice() : decay(0.999) {}
+    using SoundType = SineWaveSound;
+
+    SineWaveVoice() { state.decay = 0.999; }
 
     bool canPlaySound (juce::SynthesiserSound* sound) override
     {
-        return dynamic_cast<SineWaveSound*> (sound) != nullptr;
+        return static_cast<TypedSound*> (sound)->kind == TypedSound::Kind::sineWave;
     }
 
     void startNote (int midiNoteNumber, float velocity,
                     juce::SynthesiserSound*, int /*currentPitchWheelPosition*/) override
     {
-        currentAngle = 0.0;
-        level = velocity * 0.15;
-        tailOff = 0.0;
+        ++noteCounter;
+        state.currentAngle = 0.0;
+        state.level = NoteResponse::getGain (noteResponse, midiNoteNumber, velocity) * 0.15;
+        state.tailOff = 0.0;
 
         auto cyclesPerSecond = juce::MidiMessage::getMidiNoteInHertz (midiNoteNumber);
         auto cyclesPerSample = cyclesPerSecond / getSampleRate();
 
-        angleDelta = cyclesPerSample * 2.0 * juce::MathConstants<double>::pi;
+        state.angleDelta = cyclesPerSample * 2.0 * juce::MathConstants<double>::pi;
     }
 
     void stopNote (float /*velocity*/, bool allowTailOff) override
     {
         if (allowTailOff)
         {
-            if (tailOff == 0.0)
-                tailOff = 1.0;
+            if (state.tailOff == 0.0)
+                state.tailOff = 1.0;
         }
         else
         {
             clearCurrentNote();
-            angleDelta = 0.0;
+            state.angleDelta = 0.0;
         }
     }
 
@@ -98,242 +184,2221 @@ struct SineWaveVoice   : public juce::SynthesiserVoice
 
     void setDecay(double newDecay)
     {
-        decay = newDecay;
+        state.decay = newDecay;
     }
 
+    // Takes the decay from a parameter shared by every voice, as it's smoothed,
+    // rather than from setDecay(). The ramp is indexed by startSample.
+    void setDecaySource (const SmoothedParameter* source)    { decaySource = source; }
+
+    // The velocity and key-tracking curves that set each note's level.
+    void setNoteResponse (const NoteResponse* response)      { noteResponse = response; }
+
+    // With a lane set, the voice writes only to that channel of the buffer it's
+    // given, so that per-voice processing can happen before the mix.
+    void setOutputLane (int newLane)    { outputLane = newLane; }
+
     void renderNextBlock (juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples) override
     {
-        if (angleDelta != 0.0)
+        auto& kernels = RenderKernels::getActive();
+
+        render (kernels, startSample, numSamples, [&] (int start, const float* samples, int num)
+        {
+            if (outputLane >= 0)
+                kernels.mix (outputBuffer.getArrayOfWritePointers() + outputLane, 1, start, samples, num);
+            else
+                kernels.mix (outputBuffer.getArrayOfWritePointers(), outputBuffer.getNumChannels(),
+                             start, samples, num);
+        });
+    }
+
+    // Called by StaticSynthesiser, which knows the channel count at compile time.
+    template <int numChannels>
+    void renderStatic (float* const* channels, int startSample, int numSamples)
+    {
+        render (RenderKernels::getActive(), startSample, numSamples, [channels] (int start, const float* samples, int num)
         {
-            if (tailOff > 0.0) // [7]
+            StaticChannelMix<numChannels>::mix (channels, start, samples, num);
+        });
+    }
+
+    bool isSounding() const noexcept            { return state.angleDelta != 0.0; }
+    juce::uint32 getNoteCounter() const noexcept  { return noteCounter; }
+
+private:
+    template <typename MixFunction>
+    forcedinline void render (const RenderKernels& kernels, int startSample, int numSamples, MixFunction&& mix)
+    {
+        if (state.angleDelta != 0.0)
+        {
+            SYNTH_TRACE_SCOPE ("sine voice");
+            alignas (64) float voiceSamples[RenderKernels::maxChunkSize];
+            auto* decays = readDecay();
+
+            while (numSamples > 0)
             {
-                while (--numSamples >= 0)
-                {
-                    auto currentSample = (float) (std::sin (currentAngle) * level * tailOff);
+                auto numThisTime = juce::jmin (numSamples, RenderKernels::maxChunkSize);
 
-                    for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
-                        outputBuffer.addSample (i, startSample, currentSample);
+                if (state.tailOff > 0.0) // [7]
+                {
+                    int numRendered;
 
-                    currentAngle += angleDelta;
-                    ++startSample;
+                    if (decays != nullptr)
+                    {
+                        kernels.oscillator (voiceSamples, numThisTime, state);
+                        numRendered = applyDecayRamp (voiceSamples, numThisTime, 1.0, state, decays + startSample);
+                    }
+                    else
+                    {
+                        numRendered = kernels.tailOff (voiceSamples, numThisTime, state); // [8]
+                    }
 
-                    tailOff *= decay; // [8]
+                    mix (startSample, voiceSamples, numRendered);
 
-                    if (tailOff <= 0.005)
+                    if (state.tailOff <= 0.005)
                     {
                         clearCurrentNote(); // [9]
 
-                        angleDelta = 0.0;
+                        state.angleDelta = 0.0;
                         break;
                     }
                 }
-            }
-            else
-            {
-                while (--numSamples >= 0) // [6]
+                else
                 {
-                    auto currentSample = (float) (std::sin (currentAngle) * level);
-
-                    for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
-                        outputBuffer.addSample (i, startSample, currentSample);
-
-                    currentAngle += angleDelta;
-                    ++startSample;
+                    kernels.oscillator (voiceSamples, numThisTime, state); // [6]
+                    mix (startSample, voiceSamples, numThisTime);
                 }
+
+                startSample += numThisTime;
+                numSamples  -= numThisTime;
             }
         }
     }
 
-private:
-    double currentAngle = 0.0, angleDelta = 0.0, level = 0.0, tailOff = 0.0;
-    double decay = 0.0;
+    // The decay ramp for this block if it's being smoothed, or nullptr with
+    // state.decay up to date if not.
+    const float* readDecay() noexcept
+    {
+        if (decaySource == nullptr)
+            return nullptr;
+
+        state.decay = decaySource->getValue();
+        return decaySource->getRamp();
+    }
+
+    VoiceRenderState state;
+    const SmoothedParameter* decaySource = nullptr;
+    const NoteResponse* noteResponse = nullptr;
+    juce::uint32 noteCounter = 0;
+    int outputLane = -1;
 };
 
 //==============================================================================
-class SynthAudioSource   : public juce::AudioSource
+struct FmSound final   : public TypedSound
 {
-public:
-    SynthAudioSource (juce::MidiKeyboardState& keyState)
-        : keyboardState (keyState)
+    FmSound() : TypedSound (Kind::fm) {}
+
+    bool appliesToNote    (int) override                { return true; }
+    bool appliesToChannel (int midiChannel) override    { return isSelected (midiChannel); }
+};
+
+//==============================================================================
+// A thin handle on one lane of an FmVoiceBank, which holds the operators and
+// renders all of its lanes together.
+struct FmVoice final   : public juce::SynthesiserVoice
+{
+    using SoundType = FmSound;
+
+    FmVoice (FmVoiceBank& bankToUse, int laneIndex)
+        : bank (bankToUse), lane (laneIndex)
     {
-        for (auto i = 0; i < 4; ++i)                // [1]
-            synth.addVoice (new SineWaveVoice());
+    }
 
-        synth.addSound (new SineWaveSound());       // [2]
+    bool canPlaySound (juce::SynthesiserSound* sound) override
+    {
+        return static_cast<TypedSound*> (sound)->kind == TypedSound::Kind::fm;
     }
 
-    juce::MidiMessageCollector* getMidiCollector()
+    void startNote (int midiNoteNumber, float velocity,
+                    juce::SynthesiserSound*, int /*currentPitchWheelPosition*/) override
     {
-        return &midiCollector;
+        if (partBank != nullptr)
+            outputLane = firstPartLane + PartBank::getPart (*this);
+
+        ++noteCounter;
+        bank.startLane (lane, juce::MidiMessage::getMidiNoteInHertz (midiNoteNumber), velocity,
+                        NoteResponse::getGain (noteResponse, midiNoteNumber, velocity), getSampleRate());
     }
 
-    void setUsingSineWaveSound()
+    void stopNote (float /*velocity*/, bool allowTailOff) override
     {
-        synth.clearSounds();
+        if (allowTailOff)
+        {
+            bank.releaseLane (lane, getSampleRate());
+        }
+        else
+        {
+            bank.stopLane (lane);
+            clearCurrentNote();
+        }
     }
 
-    void prepareToPlay (int /*samplesPerBlockExpected*/, double sampleRate) override
+    void pitchWheelMoved (int) override      {}
+    void controllerMoved (int, int) override {}
+
+    void setOutputLane (int newLane)    { outputLane = newLane; }
+    void setNoteResponse (const NoteResponse* response)      { noteResponse = response; }
+
+    // Sends each note to the lane of the part that plays it, counting parts
+    // from firstLane.
+    void setPartLanes (PartBank* bank, int firstLane)    { partBank = bank; firstPartLane = firstLane; }
+
+    void renderNextBlock (juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples) override
     {
-        synth.setCurrentPlaybackSampleRate (sampleRate); // [3]
-        midiCollector.reset(sampleRate);
+        // Even with nothing to play, the bank has to move on to the end of the
+        // stretch, or a note starting after it would be rendered from the
+        // start of the block and lose its first samples.
+        bank.renderUpTo (startSample + numSamples);
+
+        if (! bank.isLaneActive (lane))
+            return;
+
+        SYNTH_TRACE_SCOPE ("fm voice");
+
+        auto& kernels = RenderKernels::getActive();
+        float* const* channels = outputBuffer.getArrayOfWritePointers();
+        auto numChannels = outputBuffer.getNumChannels();
+
+        if (outputLane >= 0)
+        {
+            channels += outputLane;
+            numChannels = 1;
+        }
+
+        if (partBank != nullptr)
+            partBank->markLaneUsed (outputLane - firstPartLane);
+
+        alignas (64) float voiceSamples[RenderKernels::maxChunkSize];
+
+        for (int start = 0; start < numSamples; start += RenderKernels::maxChunkSize)
+        {
+            auto n = juce::jmin (RenderKernels::maxChunkSize, numSamples - start);
+            bank.copyLane (lane, voiceSamples, startSample + start, n);
+            kernels.mix (channels, numChannels, startSample + start, voiceSamples, n);
+        }
+
+        if (bank.hasLaneFinished (lane))
+        {
+            bank.stopLane (lane);
+            clearCurrentNote();
+        }
     }
 
-    void releaseResources() override {}
+    bool isSounding() const noexcept              { return bank.isLaneActive (lane); }
+    juce::uint32 getNoteCounter() const noexcept  { return noteCounter; }
 
-    void getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill) override
+private:
+    FmVoiceBank& bank;
+    const int lane;
+    const NoteResponse* noteResponse = nullptr;
+    juce::uint32 noteCounter = 0;
+    int outputLane = -1, firstPartLane = 0;
+    PartBank* partBank = nullptr;
+};
+
+//==============================================================================
+// A timbre made of sine partials at fixed ratios of the note's frequency. The
+// partial table lives in the sound, so every voice playing it shares one copy.
+struct AdditiveSound final   : public TypedSound
+{
+    struct Partial
     {
-        bufferToFill.clearActiveBufferRegion();
+        float ratio, amplitude;
+    };
+
+    // The partials are sorted by ratio and their amplitudes scaled to sum to 1.
+    explicit AdditiveSound (juce::Array<Partial> newPartials)
+        : TypedSound (Kind::additive), partials (std::move (newPartials))
+    {
+        std::sort (partials.begin(), partials.end(), [] (const Partial& a, const Partial& b) { return a.ratio < b.ratio; });
 
-        juce::MidiBuffer incomingMidi;
-        midiCollector.removeNextBlockOfMessages(incomingMidi,
-            bufferToFill.startSample);
+        auto total = 0.0f;
 
-        keyboardState.processNextMidiBuffer (incomingMidi, bufferToFill.startSample,
-                                             bufferToFill.numSamples, true);       // [4]
+        for (auto& p : partials)
+            total += std::abs (p.amplitude);
 
-        synth.renderNextBlock (*bufferToFill.buffer, incomingMidi,
-                               bufferToFill.startSample, bufferToFill.numSamples); // [5]
+        if (total > 0.0f)
+            for (auto& p : partials)
+                p.amplitude /= total;
     }
 
-    void setDecay(double newDecay)
+    // A tonewheel organ with every drawbar fully out.
+    static juce::Array<Partial> createOrgan()
     {
-        for (int i = 0; i < synth.getNumVoices(); ++i) {
-            if (auto* sineWaveVoice = dynamic_cast<SineWaveVoice*>(synth.getVoice(i))) {
-                sineWaveVoice->setDecay(newDecay);
-            }
-        }
+        return { { 0.5f, 1.0f }, { 1.5f, 1.0f }, { 1.0f, 1.0f }, { 2.0f, 1.0f }, { 3.0f, 1.0f },
+                 { 4.0f, 1.0f }, { 5.0f, 1.0f }, { 6.0f, 1.0f }, { 8.0f, 1.0f } };
+    }
+
+    // A band-limited sawtooth, which needs a partial for every harmonic.
+    static juce::Array<Partial> createSawtooth (int numPartials)
+    {
+        juce::Array<Partial> result;
+
+        for (int k = 1; k <= numPartials; ++k)
+            result.add ({ (float) k, 1.0f / (float) k });
+
+        return result;
     }
 
+    bool appliesToNote    (int) override                { return true; }
+    bool appliesToChannel (int midiChannel) override    { return isSelected (midiChannel); }
+
+    const juce::Array<Partial>& getPartials() const noexcept    { return partials; }
+
 private:
-    juce::MidiKeyboardState& keyboardState;
-    juce::Synthesiser synth;
-    juce::MidiMessageCollector midiCollector;
+    juce::Array<Partial> partials;
 };
 
 //==============================================================================
-class MainContentComponent   : public juce::AudioAppComponent,
-                               private juce::Timer,
-                               public juce::Slider::Listener
+// Sums up to maxPartials sines with the partials kernel. The phasor of each
+// partial is set up from the same angle per sample as SineWaveVoice, and the
+// level and tail-off envelope behave the same way too. Partials at or above
+// Nyquist are dropped when the note starts.
+struct AdditiveVoice final   : public juce::SynthesiserVoice
 {
-public:
-    MainContentComponent()
-        : synthAudioSource  (keyboardState),
-          keyboardComponent (keyboardState, juce::MidiKeyboardComponent::horizontalKeyboard)
+    using SoundType = AdditiveSound;
+
+    static constexpr int maxPartials = 256;
+
+    AdditiveVoice()
+        : groups ((size_t) maxPartials / PartialGroup::numLanes)
     {
-        addAndMakeVisible(decaySlider);
-        decaySlider.setRange(0.999, 0.99999);
-        decaySlider.addListener(this);
+        state.decay = 0.999;
+    }
 
-        addAndMakeVisible(decayLabel);
-        decayLabel.setText("Decay", juce::dontSendNotification);
-        decayLabel.attachToComponent(&decaySlider, true);
+    bool canPlaySound (juce::SynthesiserSound* sound) override
+    {
+        return static_cast<TypedSound*> (sound)->kind == TypedSound::Kind::additive;
+    }
 
-        addAndMakeVisible(midiInputListLabel);
-        midiInputListLabel.setText("MIDI Input:", juce::dontSendNotification);
-        midiInputListLabel.attachToComponent(&midiInputList, true);
+    void startNote (int midiNoteNumber, float velocity,
+                    juce::SynthesiserSound* sound, int /*currentPitchWheelPosition*/) override
+    {
+        if (partBank != nullptr)
+            outputLane = firstPartLane + PartBank::getPart (*this);
 
-        auto midiInputs = juce::MidiInput::getAvailableDevices();
-        addAndMakeVisible(midiInputList);
-        midiInputList.setTextWhenNoChoicesAvailable("No MIDI Inputs Enabled");
+        state.level = NoteResponse::getGain (noteResponse, midiNoteNumber, velocity) * 0.15;
+        state.tailOff = 0.0;
 
-        juce::StringArray midiInputNames;
-        for (auto input : midiInputs) {
-            midiInputNames.add(input.name);
-        }
+        auto cyclesPerSecond = juce::MidiMessage::getMidiNoteInHertz (midiNoteNumber);
+        auto cyclesPerSample = cyclesPerSecond / getSampleRate();
+
+        state.angleDelta = cyclesPerSample * 2.0 * juce::MathConstants<double>::pi;
 
-        midiInputList.addItemList(midiInputNames, 1);
-        midiInputList.onChange = [this] {setMidiInput(midiInputList.getSelectedItemIndex()); };
+        numPartials = 0;
 
-        for (auto input : midiInputs) {
-            if (deviceManager.isMidiInputDeviceEnabled(input.identifier)) {
-                setMidiInput(midiInputs.indexOf(input));
+        for (auto& partial : static_cast<AdditiveSound*> (sound)->getPartials())
+        {
+            auto angle = state.angleDelta * partial.ratio;
+
+            if (numPartials == maxPartials || angle >= juce::MathConstants<double>::pi)
                 break;
-            }
-        }
 
-        if (midiInputList.getSelectedId() == 0) {
-            setMidiInput(0);
-        }
+            auto& g = groups[(size_t) numPartials / PartialGroup::numLanes];
+            auto l = numPartials % PartialGroup::numLanes;
 
-        addAndMakeVisible (keyboardComponent);
-        setAudioChannels (0, 2);
+            g.re[l] = 1.0f;
+            g.im[l] = 0.0f;
+            g.cosine[l] = (float) std::cos (angle);
+            g.sine[l] = (float) std::sin (angle);
+            g.amplitude[l] = partial.amplitude;
+            ++numPartials;
+        }
 
-        setSize (600, 160);
-        startTimer (400);
+        for (int i = numPartials; i % PartialGroup::numLanes != 0; ++i)
+        {
+            auto& g = groups[(size_t) i / PartialGroup::numLanes];
+            auto l = i % PartialGroup::numLanes;
+            g.re[l] = g.im[l] = g.amplitude[l] = 0.0f;
+        }
     }
 
-    ~MainContentComponent() override
+    void stopNote (float /*velocity*/, bool allowTailOff) override
     {
-        shutdownAudio();
+        if (allowTailOff)
+        {
+            if (state.tailOff == 0.0)
+                state.tailOff = 1.0;
+        }
+        else
+        {
+            clearCurrentNote();
+            state.angleDelta = 0.0;
+        }
     }
 
-    void resized() override
-    {
-        midiInputList.setBounds(200, 10, getWidth() - 210, 20);
-        decaySlider.setBounds(120, 40, getWidth() - 130, 20);
-        keyboardComponent.setBounds (10, 70, getWidth() - 20, getHeight() - 20);
-    }
+    void pitchWheelMoved (int) override      {}
+    void controllerMoved (int, int) override {}
 
-    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
+    void setDecay (double newDecay)     { state.decay = newDecay; }
+    void setOutputLane (int newLane)    { outputLane = newLane; }
+
+    void setDecaySource (const SmoothedParameter* source)    { decaySource = source; }
+    void setNoteResponse (const NoteResponse* response)      { noteResponse = response; }
+
+    // Sends each note to the lane of the part that plays it, counting parts
+    // from firstLane.
+    void setPartLanes (PartBank* bank, int firstLane)    { partBank = bank; firstPartLane = firstLane; }
+
+    void renderNextBlock (juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples) override
     {
-        synthAudioSource.prepareToPlay (samplesPerBlockExpected, sampleRate);
+        if (state.angleDelta == 0.0)
+            return;
+
+        SYNTH_TRACE_SCOPE ("additive voice");
+
+        auto& kernels = RenderKernels::getActive();
+        float* const* channels = outputBuffer.getArrayOfWritePointers();
+        auto numChannels = outputBuffer.getNumChannels();
+
+        if (outputLane >= 0)
+        {
+            channels += outputLane;
+            numChannels = 1;
+        }
+
+        if (partBank != nullptr)
+            partBank->markLaneUsed (outputLane - firstPartLane);
+
+        auto numGroups = (numPartials + PartialGroup::numLanes - 1) / PartialGroup::numLanes;
+        alignas (64) float voiceSamples[RenderKernels::maxChunkSize];
+        auto* decays = readDecay();
+
+        while (numSamples > 0)
+        {
+            auto numThisTime = juce::jmin (numSamples, RenderKernels::maxChunkSize);
+            kernels.partials (voiceSamples, numThisTime, groups.data(), numGroups);
+
+            if (state.tailOff > 0.0)
+            {
+                auto numRendered = decays != nullptr ? applyDecayRamp (voiceSamples, numThisTime, state.level, state, decays + startSample)
+                                                     : applyTailOff (voiceSamples, numThisTime);
+                kernels.mix (channels, numChannels, startSample, voiceSamples, numRendered);
+
+                if (state.tailOff <= 0.005)
+                {
+                    clearCurrentNote();
+
+                    state.angleDelta = 0.0;
+                    break;
+                }
+            }
+            else
+            {
+                juce::FloatVectorOperations::multiply (voiceSamples, (float) state.level, numThisTime);
+                kernels.mix (channels, numChannels, startSample, voiceSamples, numThisTime);
+            }
+
+            startSample += numThisTime;
+            numSamples  -= numThisTime;
+        }
     }
 
-    void getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill) override
+    bool isSounding() const noexcept    { return state.angleDelta != 0.0; }
+
+private:
+    int applyTailOff (float* samples, int num) noexcept
     {
-        synthAudioSource.getNextAudioBlock (bufferToFill);
+        for (int i = 0; i < num; ++i)
+        {
+            samples[i] *= (float) (state.level * state.tailOff);
+            state.tailOff *= state.decay;
+
+            if (state.tailOff <= 0.005)
+                return i + 1;
+        }
+
+        return num;
     }
 
-    void releaseResources() override
+    const float* readDecay() noexcept
     {
-        synthAudioSource.releaseResources();
+        if (decaySource == nullptr)
+            return nullptr;
+
+        state.decay = decaySource->getValue();
+        return decaySource->getRamp();
     }
 
-    void sliderValueChanged(juce::Slider* slider) override
+    VoiceRenderState state;
+    const SmoothedParameter* decaySource = nullptr;
+    const NoteResponse* noteResponse = nullptr;
+    std::vector<PartialGroup> groups;
+    int numPartials = 0, outputLane = -1, firstPartLane = 0;
+    PartBank* partBank = nullptr;
+};
+
+//==============================================================================
+struct StreamingSamplerSound final   : public TypedSound
+{
+    explicit StreamingSamplerSound (std::shared_ptr<SampleLibrary> libraryToUse)
+        : TypedSound (Kind::sampler), library (std::move (libraryToUse))
     {
-        if (slider == &decaySlider) {
-            synthAudioSource.setDecay(decaySlider.getValue());
-        }
     }
 
+    bool appliesToNote (int midiNoteNumber) override    { return library->findZone (midiNoteNumber) != nullptr; }
+    bool appliesToChannel (int midiChannel) override    { return isSelected (midiChannel); }
+
+    SampleLibrary& getLibrary() const noexcept          { return *library; }
+
 private:
-    void timerCallback() override
+    std::shared_ptr<SampleLibrary> library;
+};
+
+//==============================================================================
+// Plays a zone from its preloaded head and then from the voice's stream,
+// resampled with linear interpolation. The level and tail-off work the same
+// way as SineWaveVoice's.
+struct StreamingSamplerVoice final   : public juce::SynthesiserVoice
+{
+    using SoundType = StreamingSamplerSound;
+
+    static constexpr double maxPitchRatio = 4.0;   // source frames per output sample
+
+    StreamingSamplerVoice (SampleStreamer& streamer, int streamIndex)
+        : stream (streamer, streamIndex)
     {
-        keyboardComponent.grabKeyboardFocus();
-        stopTimer();
+        state.decay = 0.999;
     }
 
-    void setMidiInput(int index)
+    bool canPlaySound (juce::SynthesiserSound* sound) override
     {
-        auto list = juce::MidiInput::getAvailableDevices();
+        return static_cast<TypedSound*> (sound)->kind == TypedSound::Kind::sampler;
+    }
 
-        deviceManager.removeMidiInputDeviceCallback(list[lastInputIndex].identifier,
-            synthAudioSource.getMidiCollector());
+    void startNote (int midiNoteNumber, float velocity,
+                    juce::SynthesiserSound* sound, int /*currentPitchWheelPosition*/) override
+    {
+        if (partBank != nullptr)
+            outputLane = firstPartLane + PartBank::getPart (*this);
 
-        auto newInput = list[index];
+        zone = static_cast<StreamingSamplerSound*> (sound)->getLibrary().findZone (midiNoteNumber);
 
-        if (! deviceManager.isMidiInputDeviceEnabled(newInput.identifier)) {
-            deviceManager.setMidiInputDeviceEnabled(newInput.identifier, true);
+        if (zone == nullptr)
+        {
+            clearCurrentNote();
+            return;
         }
 
-        deviceManager.addMidiInputDeviceCallback(newInput.identifier,
-            synthAudioSource.getMidiCollector());
-        midiInputList.setSelectedId(index + 1, juce::dontSendNotification);
+        headFrames = stream.start (zone) ? zone->headLength : 0;
+        pitchRatio = juce::jmin (maxPitchRatio, std::pow (2.0, (midiNoteNumber - zone->rootNote) / 12.0)
+                                                  * zone->sampleRate / getSampleRate());
+
+        position = 0.0;
+        windowStart = nextFrame = 0;
+        windowLength = 0;
 
-        lastInputIndex = index;
+        state.level = NoteResponse::getGain (noteResponse, midiNoteNumber, velocity);
+        state.tailOff = 0.0;
     }
 
-    //==========================================================================
-    juce::MidiKeyboardState keyboardState;
-    SynthAudioSource synthAudioSource;
-    juce::MidiKeyboardComponent keyboardComponent;
+    void stopNote (float /*velocity*/, bool allowTailOff) override
+    {
+        if (allowTailOff)
+        {
+            if (state.tailOff == 0.0)
+                state.tailOff = 1.0;
+        }
+        else
+        {
+            finish();
+        }
+    }
 
-    juce::ComboBox midiInputList;
-    juce::Label midiInputListLabel;
-    int lastInputIndex = 0;
+    void pitchWheelMoved (int) override      {}
+    void controllerMoved (int, int) override {}
 
-    juce::Slider decaySlider;
-    juce::Label decayLabel;
+    void setDecay (double newDecay)     { state.decay = newDecay; }
+    void setOutputLane (int newLane)    { outputLane = newLane; }
+
+    void setDecaySource (const SmoothedParameter* source)    { decaySource = source; }
+    void setNoteResponse (const NoteResponse* response)      { noteResponse = response; }
+
+    // Sends each note to the lane of the part that plays it, counting parts
+    // from firstLane.
+    void setPartLanes (PartBank* bank, int firstLane)    { partBank = bank; firstPartLane = firstLane; }
+
+    void renderNextBlock (juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples) override
+    {
+        if (zone == nullptr)
+            return;
+
+        SYNTH_TRACE_SCOPE ("sampler voice");
+
+        auto& kernels = RenderKernels::getActive();
+        float* const* channels = outputBuffer.getArrayOfWritePointers();
+        auto numChannels = outputBuffer.getNumChannels();
+
+        if (outputLane >= 0)
+        {
+            channels += outputLane;
+            numChannels = 1;
+        }
+
+        if (partBank != nullptr)
+            partBank->markLaneUsed (outputLane - firstPartLane);
+
+        alignas (64) float voiceSamples[RenderKernels::maxChunkSize];
+        auto* decays = readDecay();
+
+        while (numSamples > 0)
+        {
+            auto numThisTime = juce::jmin (numSamples, RenderKernels::maxChunkSize);
+            auto numRendered = numThisTime;
+
+            fillWindow ((juce::int64) (position + pitchRatio * numThisTime) + 1);
+
+            for (int i = 0; i < numThisTime; ++i)
+            {
+                auto p = position - (double) windowStart;
+                auto index = (int) p;
+                auto frac = (float) (p - index);
+
+                voiceSamples[i] = window[index] + frac * (window[index + 1] - window[index]);
+                position += pitchRatio;
+            }
+
+            if (state.tailOff > 0.0)
+            {
+                numRendered = decays != nullptr ? applyDecayRamp (voiceSamples, numThisTime, state.level, state, decays + startSample)
+                                                : applyTailOff (voiceSamples, numThisTime);
+            }
+            else
+            {
+                juce::FloatVectorOperations::multiply (voiceSamples, (float) state.level, numThisTime);
+            }
+
+            kernels.mix (channels, numChannels, startSample, voiceSamples, numRendered);
+
+            if (state.tailOff > 0.0 && state.tailOff <= 0.005)
+            {
+                finish();
+                break;
+            }
+
+            if (position >= (double) zone->lengthInSamples)
+            {
+                finish();
+                break;
+            }
+
+            startSample += numThisTime;
+            numSamples  -= numThisTime;
+        }
+    }
+
+    bool isSounding() const noexcept    { return zone != nullptr; }
+
+private:
+    void finish()
+    {
+        clearCurrentNote();
+
+        if (zone != nullptr)
+            stream.stop();
+
+        zone = nullptr;
+    }
+
+    // Makes the source frames from the current position up to lastFrame
+    // available in the window.
+    void fillWindow (juce::int64 lastFrame) noexcept
+    {
+        auto keepFrom = (juce::int64) position;
+        auto numToDrop = (int) (keepFrom - windowStart);
+
+        if (numToDrop > 0)
+        {
+            jassert (numToDrop <= windowLength);
+            std::memmove (window, window + numToDrop, sizeof (float) * (size_t) (windowLength - numToDrop));
+            windowLength -= numToDrop;
+            windowStart = keepFrom;
+        }
+
+        auto numNeeded = (int) (lastFrame + 1 - (windowStart + windowLength));
+        jassert (windowLength + numNeeded <= windowSize);
+
+        if (numNeeded > 0)
+        {
+            fetch (window + windowLength, numNeeded);
+            windowLength += numNeeded;
+        }
+    }
+
+    // The next frames of the zone: from the head while it lasts, then from the
+    // stream, and silence past the end.
+    void fetch (float* dest, int numFrames) noexcept
+    {
+        if (nextFrame < headFrames)
+        {
+            auto n = (int) juce::jmin ((juce::int64) numFrames, headFrames - nextFrame);
+            std::copy_n (zone->head.getReadPointer (0, (int) nextFrame), n, dest);
+            dest += n;
+            numFrames -= n;
+            nextFrame += n;
+        }
+
+        auto numStreamed = (int) juce::jlimit ((juce::int64) 0, (juce::int64) numFrames, zone->lengthInSamples - nextFrame);
+
+        if (numStreamed > 0)
+            stream.read (dest, numStreamed);
+
+        std::fill (dest + numStreamed, dest + numFrames, 0.0f);
+        nextFrame += numFrames;
+    }
+
+    int applyTailOff (float* samples, int num) noexcept
+    {
+        for (int i = 0; i < num; ++i)
+        {
+            samples[i] *= (float) (state.level * state.tailOff);
+            state.tailOff *= state.decay;
+
+            if (state.tailOff <= 0.005)
+                return i + 1;
+        }
+
+        return num;
+    }
+
+    const float* readDecay() noexcept
+    {
+        if (decaySource == nullptr)
+            return nullptr;
+
+        state.decay = decaySource->getValue();
+        return decaySource->getRamp();
+    }
+
+    static constexpr int windowSize = 2048;
+
+    SampleStreamer::Reader stream;
+    SampleZone* zone = nullptr;
+    VoiceRenderState state;
+    const SmoothedParameter* decaySource = nullptr;
+    const NoteResponse* noteResponse = nullptr;
+
+    double position = 0.0, pitchRatio = 1.0;
+    juce::int64 headFrames = 0, nextFrame = 0, windowStart = 0;
+    int windowLength = 0, outputLane = -1, firstPartLane = 0;
+    PartBank* partBank = nullptr;
+    float window[windowSize];
+};
+
+//==============================================================================
+class SynthAudioSource   : public juce::AudioSource
+{
+public:
+    static constexpr int numVoices = 4;
+    static constexpr int numFmVoices = 64;
+    static constexpr int numAdditiveVoices = 8;
+    static constexpr int numSamplerVoices = 16;
+    static constexpr int maxOversamplingOrder = 3;   // 2^3 = 8x
+
+    SynthAudioSource()
+    {
+        for (auto i = 0; i < numVoices; ++i)        // [1]
+            addVoice (new SineWaveVoice());
+
+        for (auto i = 0; i < numFmVoices; ++i)
+            addVoice (new FmVoice (fmBank, i));
+
+        for (auto i = 0; i < numAdditiveVoices; ++i)
+            addVoice (new AdditiveVoice());
+
+        for (auto i = 0; i < numSamplerVoices; ++i)
+            addVoice (new StreamingSamplerVoice (streamer, i));
+
+        addSound (new SineWaveSound(), EnginePreset::sineSound);             // [2]
+        addSound (new FmSound(), EnginePreset::fmSound);
+        addSound (new AdditiveSound (AdditiveSound::createOrgan()), EnginePreset::organSound);
+        addSound (new AdditiveSound (AdditiveSound::createSawtooth (AdditiveVoice::maxPartials)), EnginePreset::sawtoothSound);
+    }
+
+    // Where the MIDI input devices' callbacks go.
+    MidiInputMerger& getMidiInputs() noexcept
+    {
+        return midiInputs;
+    }
+
+    // Low-latency mode cuts the fixed cost of each block, for running at 16
+    // or 32 sample buffers: a block with no MIDI while nothing is sounding
+    // skips the synth and the lanes altogether.
+    void setLowLatencyMode (bool shouldBeEnabled)      { lowLatencyMode = shouldBeEnabled; }
+    bool isLowLatencyMode() const noexcept             { return lowLatencyMode.load(); }
+
+    // Real-time scheduling, pinning and memory locking for the thread that
+    // calls getNextAudioBlock. Set the options before the audio starts.
+    RealtimeSetup& getRealtimeSetup() noexcept         { return realtime; }
+
+    // The notes taken from the MIDI inputs, for a KeyboardBridge to show.
+    NoteDisplayFeed& getNoteDisplay() noexcept         { return noteDisplay; }
+
+    // Times note-ons from the MIDI inputs through to the first sound they
+    // make. Off unless asked for, as it scans every block for sound.
+    void setLatencyProbeEnabled (bool shouldBeEnabled)   { latencyProbeEnabled = shouldBeEnabled; }
+    LatencyProbe& getLatencyProbe() noexcept              { return latencyProbe; }
+
+    void setUsingSineWaveSound()
+    {
+        synth.clearSounds();
+    }
+
+    // Every sound stays in the synth, and each part picks the one that its
+    // new notes play from the start of the next block. Notes already sounding
+    // carry on with their old voice type.
+    PartBank& getParts() noexcept    { return parts; }
+
+    // Makes a library the sampler slot's sound. Only its headers have been
+    // read; the heads load in the background.
+    void setSampleLibrary (std::shared_ptr<SampleLibrary> library)
+    {
+        streamer.setLibrary (library);
+
+        for (int i = synth.getNumSounds(); --i >= 0;)
+            if (synth.getSound (i).get() == currentSamplerSound)
+                synth.removeSound (i);
+
+        currentSamplerSound = new StreamingSamplerSound (library);
+        addSound (currentSamplerSound, EnginePreset::samplerSound);
+        samplerInUse = true;
+    }
+
+    bool hasSampleLibrary() const noexcept    { return currentSamplerSound != nullptr; }
+
+    // The most memory that resident sample heads may take up.
+    void setSampleMemoryBudget (size_t bytes)                 { streamer.setMemoryBudget (bytes); }
+
+    SampleStreamer::Stats getSamplerStats() const noexcept    { return streamer.getStats(); }
+
+    //==============================================================================
+    // The settings the engine was last given, from whichever thread gave them.
+    // The MIDI input isn't the engine's to know, so it's left empty.
+    EnginePreset getPreset() const
+    {
+        EnginePreset preset;
+        preset.decay = decay;
+        preset.filterEnabled = filterBank.isEnabled();
+        preset.cutoffHz = filterBank.getCutoff();
+        preset.resonance = filterBank.getResonance();
+        preset.filterEnvelopeOctaves = filterBank.getEnvelopeAmount();
+        preset.reverbEnabled = reverb.isEnabled();
+        preset.reverbWet = reverb.getWetLevel();
+        preset.oversamplingOrder = requestedOversamplingOrder;
+        preset.fmAlgorithm = fmBank.getAlgorithmIndex();
+        preset.noteResponse = noteResponse.getSettings();
+
+        for (int part = 0; part < PartBank::numParts; ++part)
+            preset.parts[part] = parts.get (part);
+
+        return preset;
+    }
+
+    // Works out everything the preset sets here on the message thread, then
+    // hands it over with a single pointer swap. The audio thread applies all
+    // of it at the start of its next block, without allocating or stopping
+    // any notes. Recalling again before that replaces the pending preset.
+    // The preset's oversampling order is left alone, as changing it stops
+    // every note; pass it to setOversamplingOrder() to use it.
+    void recallPreset (const EnginePreset& preset)
+    {
+        auto prepared = std::make_unique<PreparedPreset>();
+        prepared->preset = preset;
+        prepared->generation = ++presetGeneration;
+
+        for (int order = 0; order <= maxOversamplingOrder; ++order)
+            prepared->voiceDecay[order] = std::pow (preset.decay, 1.0 / (1 << order));
+
+        prepared->noteTables = noteResponse.prepare (preset.noteResponse);
+        prepared->requestTicks = juce::Time::getHighResolutionTicks();
+        auto* superseded = pendingPreset.exchange (prepared.get());
+
+        // The audio thread is done with anything it has applied, and never saw
+        // a pending preset that was swapped out from under it.
+        auto applied = appliedPresetGeneration.load();
+
+        presetsInFlight.erase (std::remove_if (presetsInFlight.begin(), presetsInFlight.end(),
+                                               [=] (const std::unique_ptr<PreparedPreset>& p)
+                                               {
+                                                   return p.get() == superseded || p->generation <= applied;
+                                               }),
+                               presetsInFlight.end());
+
+        presetsInFlight.push_back (std::move (prepared));
+    }
+
+    struct RecallStats
+    {
+        int numApplied = 0;
+        double lastLatencyMs = 0.0, maxLatencyMs = 0.0;   // from recallPreset() to the block that applied it
+        double lastApplyMicros = 0.0;                     // time the audio thread spent applying it
+    };
+
+    RecallStats getRecallStats() const noexcept
+    {
+        RecallStats stats;
+        stats.numApplied = numPresetsApplied;
+        stats.lastLatencyMs = juce::Time::highResolutionTicksToSeconds (lastRecallTicks) * 1000.0;
+        stats.maxLatencyMs = juce::Time::highResolutionTicksToSeconds (maxRecallTicks) * 1000.0;
+        stats.lastApplyMicros = juce::Time::highResolutionTicksToSeconds (lastApplyTicks) * 1.0e6;
+        return stats;
+    }
+
+    struct StartupStats
+    {
+        double warmUpMs = 0.0;                 // spent in prepareToPlay's warm-up render
+        int numBlocksTimed = 0;                // of the first numStartupBlocks callbacks
+        double firstBlockMicros = 0.0, medianBlockMicros = 0.0, maxBlockMicros = 0.0;
+    };
+
+    static constexpr int numStartupBlocks = 256;
+
+    // Whether prepareToPlay ends with a silent warm-up render. On by default.
+    void setWarmUpOnPrepare (bool shouldWarmUp)        { warmUpOnPrepare = shouldWarmUp; }
+
+    // How the first callbacks after prepareToPlay compare with each other.
+    StartupStats getStartupStats() const
+    {
+        StartupStats stats;
+        stats.warmUpMs = lastWarmUpMs;
+        stats.numBlocksTimed = numStartupBlocksTimed.load (std::memory_order_acquire);
+
+        if (stats.numBlocksTimed == 0)
+            return stats;
+
+        std::vector<juce::int64> ticks (startupBlockTicks.begin(), startupBlockTicks.begin() + stats.numBlocksTimed);
+        auto toMicros = [] (juce::int64 t) { return juce::Time::highResolutionTicksToSeconds (t) * 1.0e6; };
+
+        stats.firstBlockMicros = toMicros (ticks.front());
+        std::sort (ticks.begin(), ticks.end());
+        stats.medianBlockMicros = toMicros (ticks[ticks.size() / 2]);
+        stats.maxBlockMicros = toMicros (ticks.back());
+        return stats;
+    }
+
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
+    {
+        synth.setCurrentPlaybackSampleRate (sampleRate); // [3]
+        midiInputs.reset (sampleRate);
+
+        // Room for every event the inputs could have queued, so that however
+        // dense the stream, neither buffer grows on the audio thread. The
+        // lanes only ever get a subset of the same events.
+        deviceMidi.ensureSize (MidiInputMerger::maxBlockBytes);
+
+        currentSampleRate = sampleRate;
+        preparedBlockSize = samplesPerBlockExpected;
+
+        for (int order = 1; order <= maxOversamplingOrder; ++order)
+        {
+            auto& oversampler = oversamplers[(size_t) order - 1];
+            oversampler = std::make_unique<juce::dsp::Oversampling<float>> (2, (size_t) order,
+                                                                            juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR,
+                                                                            true, true);
+            oversampler->initProcessing ((size_t) samplesPerBlockExpected);
+        }
+
+        voiceLanes.setSize (numLanes, samplesPerBlockExpected << maxOversamplingOrder);
+        fmBank.prepare (samplesPerBlockExpected << maxOversamplingOrder);
+        smoothedDecay.prepare (samplesPerBlockExpected << maxOversamplingOrder);
+        laneMidi.ensureSize (MidiInputMerger::maxBlockBytes);
+        filterBank.prepare (numVoices, sampleRate);
+        reverb.prepare (sampleRate, samplesPerBlockExpected, 2);
+
+        activeOversamplingOrder = 0;
+        applyOversamplingOrder (requestedOversamplingOrder);
+
+        if (warmUpOnPrepare)
+            warmUp (samplesPerBlockExpected);
+
+        prefaultLanes();
+        streamer.setMemoryLocked (realtime.willLockMemory());
+        realtime.lockMemoryIfRequested();
+        numStartupBlocksTimed = 0;
+    }
+
+    void releaseResources() override {}
+
+    void getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill) override
+    {
+        realtime.applyIfPending();
+
+        SYNTH_TRACE_THREAD ("Audio");
+        SYNTH_TRACE_SCOPE ("audio callback");
+
+        auto numTimed = numStartupBlocksTimed.load (std::memory_order_relaxed);
+        auto startTicks = numTimed < numStartupBlocks ? juce::Time::getHighResolutionTicks() : 0;
+
+        auto* probe = latencyProbeEnabled.load (std::memory_order_relaxed) ? &latencyProbe : nullptr;
+
+        {
+            SYNTH_TRACE_SCOPE ("midi intake");
+            deviceMidi.clear();
+            midiInputs.removeNextBlockOfMessages (deviceMidi, bufferToFill.numSamples, probe);
+        }
+
+        renderNextBlock (bufferToFill, deviceMidi);
+
+        if (noteDisplay.isEnabled())
+        {
+            SYNTH_TRACE_SCOPE ("note display");
+            noteDisplay.push (deviceMidi);
+        }
+
+        if (probe != nullptr)
+            probe->blockRendered (*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+
+        if (numTimed < numStartupBlocks)
+        {
+            startupBlockTicks[(size_t) numTimed] = juce::Time::getHighResolutionTicks() - startTicks;
+            numStartupBlocksTimed.store (numTimed + 1, std::memory_order_release);
+        }
+    }
+
+    // Renders one block from an explicit MIDI buffer whose event positions lie in
+    // [startSample, startSample + numSamples). Used directly by the offline renderer.
+    // Everything is sized in prepareToPlay for its block size, so a longer
+    // block is rendered in pieces of that size rather than growing anything.
+    void renderNextBlock (const juce::AudioSourceChannelInfo& bufferToFill, juce::MidiBuffer& incomingMidi)
+    {
+        SYNTH_TRACE_SCOPE ("render");
+        jassert (preparedBlockSize > 0);
+        bufferToFill.clearActiveBufferRegion();
+
+        applyPendingPreset();
+        noteResponse.applyPending();
+        parts.beginBlock();
+
+        auto isSplit = bufferToFill.numSamples > preparedBlockSize;
+
+        if (lowLatencyMode.load (std::memory_order_relaxed) && incomingMidi.isEmpty() && isIdle())
+        {
+            forEachPreparedChunk (bufferToFill, [this] (const juce::AudioSourceChannelInfo& chunk)
+            {
+                reverb.process (*chunk.buffer, chunk.startSample, chunk.numSamples);
+            });
+
+            return;
+        }
+
+        if (samplerInUse)
+        {
+            SYNTH_TRACE_SCOPE ("sampler prefetch");
+            prefetchSamples (incomingMidi);
+        }
+
+        forEachPreparedChunk (bufferToFill, [&] (const juce::AudioSourceChannelInfo& chunk)
+        {
+            renderVoices (chunk, incomingMidi, isSplit);                           // [5]
+            reverb.process (*chunk.buffer, chunk.startSample, chunk.numSamples);
+        });
+    }
+
+    // Renders the voices at 2^order times the device rate and filters back
+    // down. The voices can't change rate mid-note, so the change is made at
+    // the end of the next block: everything sounding, including notes that
+    // start in that block, fades out over it and is then stopped. Nothing is
+    // allocated, and setting the order that's already in use does nothing.
+    void setOversamplingOrder (int newOrder)
+    {
+        requestedOversamplingOrder = juce::jlimit (0, maxOversamplingOrder, newOrder);
+    }
+
+    // The delay that the oversampling filters add to the output, in samples at
+    // the device rate.
+    int getLatencySamples (int order) const
+    {
+        if (order <= 0 || oversamplers[(size_t) order - 1] == nullptr)
+            return 0;
+
+        return juce::roundToInt (oversamplers[(size_t) order - 1]->getLatencyInSamples());
+    }
+
+    int getLatencySamples() const                { return getLatencySamples (requestedOversamplingOrder); }
+
+    VoiceFilterBank& getFilterBank() noexcept    { return filterBank; }
+    FmVoiceBank& getFmBank() noexcept            { return fmBank; }
+    MasterReverb& getReverb() noexcept           { return reverb; }
+
+    // Curve changes apply to notes that start from the next block on.
+    NoteResponse& getNoteResponse() noexcept     { return noteResponse; }
+
+    // The decay is per sample at the device rate; oversampled voices get the
+    // equivalent per-sample factor at the rate they're running at, which the
+    // audio thread works out when it sees the change. Sounding notes glide to
+    // a new decay over decaySmoothingSeconds.
+    void setDecay(double newDecay)
+    {
+        decay = newDecay;
+    }
+
+    static constexpr double decaySmoothingSeconds = 0.05;
+
+private:
+    // Voices and sounds only go in through these, so that each voice type's
+    // pointers are kept alongside the synth's untyped list and every sound
+    // the synth sees is a TypedSound.
+    void addVoice (SineWaveVoice* voice)
+    {
+        voice->setOutputLane (sineWaveVoices.size());
+        voice->setDecaySource (&smoothedDecay);
+        voice->setNoteResponse (&noteResponse);
+        synth.addVoice (voice);
+        sineWaveVoices.add (voice);
+    }
+
+    // The other voices play into one lane per part, after the sine voices'
+    // lanes, which the per-voice filter doesn't touch.
+    void addVoice (FmVoice* voice)
+    {
+        voice->setPartLanes (&parts, firstPartLane);
+        voice->setNoteResponse (&noteResponse);
+        synth.addVoice (voice);
+    }
+
+    void addVoice (AdditiveVoice* voice)
+    {
+        voice->setPartLanes (&parts, firstPartLane);
+        voice->setDecaySource (&smoothedDecay);
+        voice->setNoteResponse (&noteResponse);
+        synth.addVoice (voice);
+        additiveVoices.add (voice);
+    }
+
+    void addVoice (StreamingSamplerVoice* voice)
+    {
+        voice->setPartLanes (&parts, firstPartLane);
+        voice->setDecaySource (&smoothedDecay);
+        voice->setNoteResponse (&noteResponse);
+        synth.addVoice (voice);
+        samplerVoices.add (voice);
+    }
+
+    void addSound (TypedSound* sound, int slot)
+    {
+        sound->setParts (&parts, slot);
+        synth.addSound (sound);
+    }
+
+    // The block's note-ons are seen before any voice renders, so the cache can
+    // start loading the zones they and their neighbours will need.
+    void prefetchSamples (const juce::MidiBuffer& midi)
+    {
+        for (const auto metadata : midi)
+        {
+            auto message = metadata.getMessage();
+
+            if (message.isNoteOn())
+                streamer.prefetch (message.getNoteNumber());
+        }
+    }
+
+    // True when no voice wrote to a lane last block, so every lane is still
+    // silent and stays so until a note arrives. Never true while the filters
+    // or an oversampler could still be ringing, so taking the fast path
+    // doesn't change the output.
+    bool isIdle() const noexcept
+    {
+        if (lastUsedPartLanes != 0 || filterBank.isEnabled()
+             || activeOversamplingOrder != 0 || requestedOversamplingOrder.load() != 0)
+            return false;
+
+        for (auto* voice : sineWaveVoices)
+            if (voice->isVoiceActive())
+                return false;
+
+        return true;
+    }
+
+    // Plays a chord of numFmVoices notes, enough to start every FM lane, on
+    // each kind of voice for four blocks, with the filters on, into a scratch
+    // buffer; the sounds with fewer voices steal their way through it. It then
+    // stops them and resets whatever they left ringing. The first real notes then find the code, tables, MIDI
+    // buffers and voice state already warm. The sampler is left out, as its
+    // notes would start disk reads.
+    void warmUp (int blockSize)
+    {
+        auto started = juce::Time::getMillisecondCounterHiRes();
+
+        juce::AudioBuffer<float> scratch (2, blockSize);
+        juce::AudioSourceChannelInfo info (scratch);
+
+        applyPendingPreset();
+        auto savedPart = parts.get (0);
+        auto filterWasEnabled = filterBank.isEnabled();
+        filterBank.setEnabled (true);
+
+        for (auto sound : { EnginePreset::sineSound, EnginePreset::fmSound, EnginePreset::organSound, EnginePreset::sawtoothSound })
+        {
+            parts.setSound (0, sound);
+            deviceMidi.clear();
+
+            for (int note = 0; note < numFmVoices; ++note)
+                deviceMidi.addEvent (juce::MidiMessage::noteOn (1, 48 + note, 0.5f), 0);
+
+            for (int block = 0; block < 4; ++block)
+            {
+                renderNextBlock (info, deviceMidi);
+                deviceMidi.clear();
+            }
+
+            synth.allNotesOff (0, false);
+        }
+
+        renderNextBlock (info, deviceMidi);
+
+        filterBank.setEnabled (filterWasEnabled);
+        parts.set (0, savedPart);
+        applyOversamplingOrder (activeOversamplingOrder);
+        reverb.reset();
+        lastUsedPartLanes = 0;
+
+        lastWarmUpMs = juce::Time::getMillisecondCounterHiRes() - started;
+    }
+
+    // Writes to every lane sample, so that the first blocks don't take the
+    // page faults of a freshly allocated buffer.
+    void prefaultLanes()
+    {
+        for (int lane = 0; lane < voiceLanes.getNumChannels(); ++lane)
+            juce::FloatVectorOperations::clear (voiceLanes.getWritePointer (lane), voiceLanes.getNumSamples());
+    }
+
+    // Calls render (chunk) for consecutive pieces of the block no longer than
+    // the size it was prepared for; usually that's the whole block at once.
+    template <typename Renderer>
+    void forEachPreparedChunk (const juce::AudioSourceChannelInfo& bufferToFill, Renderer&& render)
+    {
+        for (int done = 0; done < bufferToFill.numSamples; done += preparedBlockSize)
+            render (juce::AudioSourceChannelInfo (bufferToFill.buffer, bufferToFill.startSample + done,
+                                                  juce::jmin (preparedBlockSize, bufferToFill.numSamples - done)));
+    }
+
+    // Stops every note. Nothing is allocated, so this is safe on the audio thread.
+    void applyOversamplingOrder (int order)
+    {
+        auto renderRate = currentSampleRate * (1 << order);
+
+        activeOversamplingOrder = order;
+        synth.setCurrentPlaybackSampleRate (renderRate);
+        filterBank.setSampleRate (renderRate);
+
+        // The per-sample factor means something different at the new rate, so
+        // it jumps rather than ramps.
+        targetDecay = decay.load();
+        smoothedDecay.setSampleRate (renderRate);
+        smoothedDecay.setCurrentAndTarget (getVoiceDecay (order));
+
+        if (order > 0)
+            oversamplers[(size_t) order - 1]->reset();
+    }
+
+    // Each sine voice renders into its own lane and goes through the per-voice
+    // filter, and every other voice renders into its part's lane. The lanes
+    // are then summed into the output in lane order (which, at unit gains,
+    // gives exactly what mixing straight into the output would have). When
+    // oversampling, all of that happens at the higher rate and the sum goes
+    // into the oversampler's buffer instead. When the block is a piece of a
+    // longer one, only the events that fall inside it are passed on.
+    void renderVoices (const juce::AudioSourceChannelInfo& bufferToFill, juce::MidiBuffer& incomingMidi, bool isPartOfBlock)
+    {
+        auto order = activeOversamplingOrder;
+        auto requestedOrder = requestedOversamplingOrder.load();
+        auto numSamples = bufferToFill.numSamples;
+        auto numLaneSamples = numSamples << order;
+        jassert (numLaneSamples <= voiceLanes.getNumSamples());
+
+        // Part lanes that nothing wrote to last block are still silent.
+        {
+            SYNTH_TRACE_SCOPE ("lane clear");
+            auto numToClear = juce::jmin (voiceLanes.getNumSamples(), juce::jmax (numLaneSamples, lastLaneSamples));
+
+            for (int lane = 0; lane < numVoices; ++lane)
+                voiceLanes.clear (lane, 0, numToClear);
+
+            for (int part = 0; part < PartBank::numParts; ++part)
+                if (((lastUsedPartLanes >> part) & 1) != 0)
+                    voiceLanes.clear (firstPartLane + part, 0, numToClear);
+        }
+
+        auto* midi = &incomingMidi;
+
+        if (bufferToFill.startSample != 0 || order != 0 || isPartOfBlock)
+        {
+            SYNTH_TRACE_SCOPE ("event split");
+            laneMidi.clear();
+
+            for (const auto metadata : incomingMidi)
+            {
+                auto position = metadata.samplePosition - bufferToFill.startSample;
+
+                if (position >= 0 && position < numSamples)
+                    laneMidi.addEvent (metadata.data, metadata.numBytes, position << order);
+            }
+
+            midi = &laneMidi;
+        }
+
+        if (decay.load() != targetDecay)
+        {
+            targetDecay = decay.load();
+            smoothedDecay.setTarget (getVoiceDecay (order));
+        }
+
+        fmBank.beginBlock (0, numLaneSamples);
+        smoothedDecay.beginBlock (numLaneSamples);
+
+        {
+            SYNTH_TRACE_SCOPE ("voices");
+            synth.renderNextBlock (voiceLanes, *midi, 0, numLaneSamples);
+        }
+
+        // Only the part lanes that voices wrote to get summed.
+        lastUsedPartLanes = parts.getUsedLanes();
+        lastLaneSamples = numLaneSamples;
+
+        if (filterBank.isEnabled())
+        {
+            SYNTH_TRACE_SCOPE ("voice filter");
+            filterBank.process (voiceLanes, numLaneSamples, sineWaveVoices);
+        }
+
+        auto* output = bufferToFill.buffer;
+
+        if (order == 0)
+        {
+            SYNTH_TRACE_SCOPE ("mix");
+            mixLanes (output->getArrayOfWritePointers(), output->getNumChannels(),
+                      bufferToFill.startSample, numSamples);
+        }
+        else
+        {
+            SYNTH_TRACE_SCOPE ("oversampling");
+            renderOversampled (*oversamplers[(size_t) order - 1], *output, bufferToFill.startSample, numSamples, numLaneSamples);
+        }
+
+        // A new factor fades this block out rather than cutting it off.
+        if (requestedOrder != order)
+        {
+            output->applyGainRamp (bufferToFill.startSample, numSamples, 1.0f, 0.0f);
+            applyOversamplingOrder (requestedOrder);
+        }
+    }
+
+    void renderOversampled (juce::dsp::Oversampling<float>& oversampler, juce::AudioBuffer<float>& output,
+                            int startSample, int numSamples, int numLaneSamples)
+    {
+        auto outputBlock = juce::dsp::AudioBlock<float> (output)
+                               .getSubsetChannelBlock (0, (size_t) juce::jmin (2, output.getNumChannels()))
+                               .getSubBlock ((size_t) startSample, (size_t) numSamples);
+
+        auto upsampled = oversampler.processSamplesUp (outputBlock);
+        upsampled.clear();
+
+        float* upsampledChannels[2] = {};
+        auto numUpsampledChannels = juce::jmin (2, (int) upsampled.getNumChannels());
+
+        for (int ch = 0; ch < numUpsampledChannels; ++ch)
+            upsampledChannels[ch] = upsampled.getChannelPointer ((size_t) ch);
+
+        mixLanes (upsampledChannels, numUpsampledChannels, 0, numLaneSamples);
+        oversampler.processSamplesDown (outputBlock);
+    }
+
+    double getVoiceDecay (int order) const
+    {
+        return order == 0 ? decay.load() : std::pow (decay.load(), 1.0 / (1 << order));
+    }
+
+    // Called at the top of every block. Everything here is a store.
+    void applyPendingPreset()
+    {
+        auto* prepared = pendingPreset.exchange (nullptr);
+
+        if (prepared == nullptr)
+            return;
+
+        SYNTH_TRACE_SCOPE ("preset apply");
+        auto startTicks = juce::Time::getHighResolutionTicks();
+        auto& preset = prepared->preset;
+
+        decay = targetDecay = preset.decay;
+        smoothedDecay.setTarget (prepared->voiceDecay[activeOversamplingOrder]);
+
+        filterBank.setEnabled (preset.filterEnabled);
+        filterBank.setCutoff (preset.cutoffHz);
+        filterBank.setResonance (preset.resonance);
+        filterBank.setEnvelopeAmount (preset.filterEnvelopeOctaves);
+
+        reverb.setEnabled (preset.reverbEnabled);
+        reverb.setWetLevel (preset.reverbWet);
+
+        for (int part = 0; part < PartBank::numParts; ++part)
+            parts.set (part, preset.parts[part]);
+
+        fmBank.setAlgorithm (preset.fmAlgorithm);
+        noteResponse.apply (prepared->noteTables);
+
+        auto endTicks = juce::Time::getHighResolutionTicks();
+        lastRecallTicks = startTicks - prepared->requestTicks;
+        maxRecallTicks = juce::jmax (maxRecallTicks.load(), lastRecallTicks.load());
+        lastApplyTicks = endTicks - startTicks;
+        ++numPresetsApplied;
+
+        appliedPresetGeneration = prepared->generation;
+    }
+
+    // Sums the sine voices' lanes and the used part lanes in one pass, each at
+    // the level and pan of its part.
+    void mixLanes (float* const* channels, int numChannels, int startSample, int numSamples)
+    {
+        const float* lanes[numLanes];
+        float gains[numLanes * 2];
+        int numToMix = 0;
+
+        for (auto* voice : sineWaveVoices)
+        {
+            lanes[numToMix] = voiceLanes.getReadPointer (numToMix);
+            parts.getGains (PartBank::getPart (*voice), gains[numToMix * 2], gains[numToMix * 2 + 1]);
+            ++numToMix;
+        }
+
+        for (int part = 0; part < PartBank::numParts; ++part)
+        {
+            if (((lastUsedPartLanes >> part) & 1) != 0)
+            {
+                lanes[numToMix] = voiceLanes.getReadPointer (firstPartLane + part);
+                parts.getGains (part, gains[numToMix * 2], gains[numToMix * 2 + 1]);
+                ++numToMix;
+            }
+        }
+
+        RenderKernels::getActive().mixLanes (channels, numChannels, startSample, lanes, gains, numToMix, numSamples);
+    }
+
+    PartBank parts;
+    PartSynthesiser synth { parts };
+    juce::Array<SineWaveVoice*> sineWaveVoices;
+    juce::Array<AdditiveVoice*> additiveVoices;
+    juce::Array<StreamingSamplerVoice*> samplerVoices;
+    MidiInputMerger midiInputs;
+    juce::MidiBuffer deviceMidi;
+    LatencyProbe latencyProbe;
+    std::atomic<bool> latencyProbeEnabled { false };
+    NoteDisplayFeed noteDisplay;
+    std::atomic<bool> lowLatencyMode { false };
+    RealtimeSetup realtime;
+
+    bool warmUpOnPrepare = true;
+    std::atomic<double> lastWarmUpMs { 0.0 };
+    std::array<juce::int64, numStartupBlocks> startupBlockTicks {};
+    std::atomic<int> numStartupBlocksTimed { numStartupBlocks };
+
+    juce::AudioBuffer<float> voiceLanes;
+    juce::MidiBuffer laneMidi;
+    VoiceFilterBank filterBank;
+    MasterReverb reverb;
+    FmVoiceBank fmBank { numFmVoices };
+    SampleStreamer streamer { numSamplerVoices };
+    std::atomic<bool> samplerInUse { false };
+
+    static constexpr int firstPartLane = numVoices, numLanes = numVoices + PartBank::numParts;
+    juce::uint32 lastUsedPartLanes = 0;
+    int lastLaneSamples = 0;
+
+    std::array<std::unique_ptr<juce::dsp::Oversampling<float>>, maxOversamplingOrder> oversamplers;
+    std::atomic<int> requestedOversamplingOrder { 0 };
+    int activeOversamplingOrder = 0, preparedBlockSize = 0;
+    double currentSampleRate = 44100.0;
+    std::atomic<double> decay { 0.999 };
+    double targetDecay = 0.999;   // the device-rate decay that smoothedDecay is heading for; audio thread only
+
+    NoteResponse noteResponse;
+
+    // Read by every sine, additive and sampler voice.
+    SmoothedParameter smoothedDecay { SmoothedParameter::Ramp::exponential, decaySmoothingSeconds, 0.999 };
+
+    StreamingSamplerSound* currentSamplerSound = nullptr;
+
+    struct PreparedPreset
+    {
+        EnginePreset preset;
+        double voiceDecay[maxOversamplingOrder + 1];
+        NoteResponse::Tables noteTables;
+        juce::uint64 generation;
+        juce::int64 requestTicks;
+    };
+
+    // Owned by the message thread, which frees them once the audio thread has
+    // moved past them.
+    std::vector<std::unique_ptr<PreparedPreset>> presetsInFlight;
+    std::atomic<PreparedPreset*> pendingPreset { nullptr };
+    std::atomic<juce::uint64> appliedPresetGeneration { 0 };
+    juce::uint64 presetGeneration = 0;
+
+    std::atomic<juce::int64> lastRecallTicks { 0 }, maxRecallTicks { 0 }, lastApplyTicks { 0 };
+    std::atomic<int> numPresetsApplied { 0 };
+
+    static_assert (maxOversamplingOrder == EnginePreset::maxOversamplingOrder, "The preset format stores the order");
+};
+
+//==============================================================================
+class MainContentComponent   : public juce::AudioAppComponent,
+                               private juce::Timer,
+                               public juce::Slider::Listener
+{
+public:
+    explicit MainContentComponent (const RealtimeSetup::Options& realtimeOptions = {})
+        : keyboardComponent (keyboardState, juce::MidiKeyboardComponent::horizontalKeyboard)
+    {
+        addAndMakeVisible(decaySlider);
+        decaySlider.setRange(EnginePreset::minDecay, EnginePreset::maxDecay);
+        decaySlider.addListener(this);
+
+        addAndMakeVisible(decayLabel);
+        decayLabel.setText("Decay", juce::dontSendNotification);
+        decayLabel.attachToComponent(&decaySlider, true);
+
+        addAndMakeVisible (filterToggle);
+        filterToggle.setButtonText ("Voice filter");
+        filterToggle.onClick = [this] { synthAudioSource.getFilterBank().setEnabled (filterToggle.getToggleState()); };
+
+        addFilterSlider (cutoffSlider, cutoffLabel, "Cutoff", 20.0, 20000.0, 2000.0);
+        cutoffSlider.setSkewFactorFromMidPoint (1000.0);
+        cutoffSlider.setTextValueSuffix (" Hz");
+
+        addFilterSlider (resonanceSlider, resonanceLabel, "Resonance", 0.5, 10.0, 0.707);
+        addFilterSlider (filterEnvSlider, filterEnvLabel, "Filter env", 0.0, 6.0, 2.0);
+        filterEnvSlider.setTextValueSuffix (" oct");
+
+        addAndMakeVisible (reverbToggle);
+        reverbToggle.setButtonText ("Reverb");
+        reverbToggle.onClick = [this] { synthAudioSource.getReverb().setEnabled (reverbToggle.getToggleState()); };
+
+        addAndMakeVisible (lowLatencyToggle);
+        lowLatencyToggle.setButtonText ("Low latency");
+        lowLatencyToggle.onClick = [this] { synthAudioSource.setLowLatencyMode (lowLatencyToggle.getToggleState()); };
+
+        // Turning this off stops the keys lighting up for incoming notes,
+        // which saves the repaints during a performance.
+        addAndMakeVisible (keyFeedbackToggle);
+        keyFeedbackToggle.setButtonText ("Key feedback");
+        keyFeedbackToggle.setToggleState (keyboardBridge.isKeyFeedbackEnabled(), juce::dontSendNotification);
+        keyFeedbackToggle.onClick = [this] { keyboardBridge.setKeyFeedbackEnabled (keyFeedbackToggle.getToggleState()); };
+
+        addAndMakeVisible (loadImpulseButton);
+        loadImpulseButton.setButtonText ("Load IR...");
+        loadImpulseButton.onClick = [this] { chooseImpulseResponse(); };
+
+        addFilterSlider (reverbWetSlider, reverbWetLabel, "Reverb wet", 0.0, 1.0, 0.3);
+
+        addAndMakeVisible (oversamplingList);
+        oversamplingList.addItemList ({ "Off", "2x", "4x", "8x" }, 1);
+        oversamplingList.setSelectedItemIndex (0, juce::dontSendNotification);
+        oversamplingList.onChange = [this]
+        {
+            synthAudioSource.setOversamplingOrder (oversamplingList.getSelectedItemIndex());
+            updateLatencyLabel();
+        };
+
+        addAndMakeVisible (oversamplingLabel);
+        oversamplingLabel.setText ("Oversampling", juce::dontSendNotification);
+        oversamplingLabel.attachToComponent (&oversamplingList, true);
+
+        addAndMakeVisible (latencyLabel);
+
+        addAndMakeVisible (soundList);
+        soundList.addItemList ({ "Sine", "FM", "Organ", "Sawtooth", "Sampler" }, 1);
+        soundList.setSelectedItemIndex (0, juce::dontSendNotification);
+        soundList.onChange = [this]
+        {
+            auto sound = soundList.getSelectedItemIndex();
+
+            if (sound == EnginePreset::samplerSound && ! synthAudioSource.hasSampleLibrary())
+            {
+                chooseSampleFolder();
+                return;
+            }
+
+            editParts ([sound] (PartBank::Settings& part) { part.sound = sound; });
+            algorithmList.setEnabled (sound == EnginePreset::fmSound);
+        };
+
+        addAndMakeVisible (soundLabel);
+        soundLabel.setText ("Sound", juce::dontSendNotification);
+        soundLabel.attachToComponent (&soundList, true);
+
+        addAndMakeVisible (algorithmList);
+
+        for (int i = 0; i < FmVoiceBank::numAlgorithms; ++i)
+            algorithmList.addItem ("Algorithm " + juce::String (i + 1), i + 1);
+
+        algorithmList.setSelectedItemIndex (0, juce::dontSendNotification);
+        algorithmList.setEnabled (false);
+        algorithmList.onChange = [this] { synthAudioSource.getFmBank().setAlgorithm (algorithmList.getSelectedItemIndex()); };
+
+        addAndMakeVisible (loadSamplesButton);
+        loadSamplesButton.setButtonText ("Load samples...");
+        loadSamplesButton.onClick = [this] { chooseSampleFolder(); };
+
+        addAndMakeVisible (partList);
+        partList.addItem ("All parts", 1);
+
+        for (int i = 0; i < PartBank::numParts; ++i)
+            partList.addItem ("Part " + juce::String (i + 1), i + 2);
+
+        partList.setSelectedItemIndex (0, juce::dontSendNotification);
+        partList.onChange = [this] { showPart (synthAudioSource.getParts().get (getEditedParts().getStart())); };
+
+        addAndMakeVisible (partLabel);
+        partLabel.setText ("Part", juce::dontSendNotification);
+        partLabel.attachToComponent (&partList, true);
+
+        addFilterSlider (partVoicesSlider, partVoicesLabel, "Voices", 1.0, PartBank::defaultPolyphony, PartBank::defaultPolyphony);
+        partVoicesSlider.setSliderStyle (juce::Slider::IncDecButtons);
+        partVoicesSlider.setRange (1.0, PartBank::defaultPolyphony, 1.0);
+
+        addFilterSlider (partLevelSlider, partLevelLabel, "Part level", 0.0, 2.0, 1.0);
+        addFilterSlider (partPanSlider, partPanLabel, "Pan", -1.0, 1.0, 0.0);
+
+        addAndMakeVisible (velocityCurveList);
+        velocityCurveList.addItemList ({ "Linear", "Soft", "Hard", "Fixed", "Power" }, 1);
+        velocityCurveList.setSelectedItemIndex (0, juce::dontSendNotification);
+        velocityCurveList.onChange = [this]
+        {
+            auto& response = synthAudioSource.getNoteResponse();
+            auto settings = response.getSettings();
+            settings.velocityCurve = velocityCurveList.getSelectedItemIndex();
+            response.setSettings (settings);
+            velocityExponentSlider.setEnabled (settings.velocityCurve == (int) NoteCurves::Velocity::power);
+        };
+
+        addAndMakeVisible (velocityCurveLabel);
+        velocityCurveLabel.setText ("Velocity", juce::dontSendNotification);
+        velocityCurveLabel.attachToComponent (&velocityCurveList, true);
+
+        addFilterSlider (velocityExponentSlider, velocityExponentLabel, "Exponent",
+                         NoteCurves::minVelocityExponent, NoteCurves::maxVelocityExponent, 1.0);
+        velocityExponentSlider.setSkewFactorFromMidPoint (1.0);
+        velocityExponentSlider.setEnabled (false);
+
+        addFilterSlider (keyTrackingSlider, keyTrackingLabel, "Key tracking",
+                         -EnginePreset::maxKeyTrackingDb, EnginePreset::maxKeyTrackingDb, 0.0);
+        keyTrackingSlider.setTextValueSuffix (" dB/oct");
+
+        addAndMakeVisible (samplerStatsLabel);
+
+        addAndMakeVisible (savePresetButton);
+        savePresetButton.setButtonText ("Save preset...");
+        savePresetButton.onClick = [this] { choosePresetFile (true); };
+
+        addAndMakeVisible (loadPresetButton);
+        loadPresetButton.setButtonText ("Load preset...");
+        loadPresetButton.onClick = [this] { choosePresetFile (false); };
+
+        addAndMakeVisible (presetStatsLabel);
+
+        addAndMakeVisible(midiInputListLabel);
+        midiInputListLabel.setText("MIDI Input:", juce::dontSendNotification);
+        midiInputListLabel.attachToComponent(&midiInputList, true);
+
+        addAndMakeVisible(midiInputList);
+        midiInputList.setTextWhenNoChoicesAvailable("No MIDI Inputs Enabled");
+        midiInputList.onChange = [this] { toggleMidiInput (midiInputList.getSelectedItemIndex()); };
+
+        // The inputs are listed when the watcher's first scan comes in, so the
+        // window never waits for the devices to be enumerated.
+        midiDeviceWatcher.onChange = [this] { midiDevicesChanged(); };
+        midiDeviceWatcher.start();
+
+        addAndMakeVisible (midiStatsLabel);
+
+        addAndMakeVisible (keyboardComponent);
+
+        synthAudioSource.getRealtimeSetup().setOptions (realtimeOptions);
+        setAudioChannels (0, 2);
+
+        setSize (600, 610);
+        startTimer (400);
+    }
+
+    ~MainContentComponent() override
+    {
+        for (auto& identifier : juce::StringArray (enabledMidiInputs))
+            setMidiInputEnabled (identifier, false);
+
+        shutdownAudio();
+    }
+
+    void resized() override
+    {
+        midiInputList.setBounds(200, 10, getWidth() - 210, 20);
+        decaySlider.setBounds(120, 40, getWidth() - 130, 20);
+        filterToggle.setBounds (120, 70, getWidth() - 130, 20);
+        cutoffSlider.setBounds (120, 100, getWidth() - 130, 20);
+        resonanceSlider.setBounds (120, 130, getWidth() - 130, 20);
+        filterEnvSlider.setBounds (120, 160, getWidth() - 130, 20);
+        reverbToggle.setBounds (120, 190, 100, 20);
+        loadImpulseButton.setBounds (230, 190, 100, 20);
+        lowLatencyToggle.setBounds (340, 190, 110, 20);
+        keyFeedbackToggle.setBounds (460, 190, getWidth() - 470, 20);
+        reverbWetSlider.setBounds (120, 220, getWidth() - 130, 20);
+        oversamplingList.setBounds (120, 250, 100, 20);
+        latencyLabel.setBounds (230, 250, getWidth() - 240, 20);
+        soundList.setBounds (120, 280, 100, 20);
+        algorithmList.setBounds (230, 280, 130, 20);
+        loadSamplesButton.setBounds (370, 280, 120, 20);
+        partList.setBounds (120, 310, 100, 20);
+        partVoicesSlider.setBounds (290, 310, 100, 20);
+        partLevelSlider.setBounds (120, 340, 200, 20);
+        partPanSlider.setBounds (370, 340, getWidth() - 380, 20);
+        midiStatsLabel.setBounds (120, 370, getWidth() - 130, 20);
+        samplerStatsLabel.setBounds (120, 400, getWidth() - 130, 20);
+        savePresetButton.setBounds (120, 430, 100, 20);
+        loadPresetButton.setBounds (230, 430, 100, 20);
+        presetStatsLabel.setBounds (340, 430, getWidth() - 350, 20);
+        velocityCurveList.setBounds (120, 460, 100, 20);
+        keyTrackingSlider.setBounds (320, 460, getWidth() - 330, 20);
+        velocityExponentSlider.setBounds (120, 490, getWidth() - 130, 20);
+        keyboardComponent.setBounds (10, 520, getWidth() - 20, getHeight() - 530);
+    }
+
+    void prepareToPlay (int samplesPerBlockExpected, double sampleRate) override
+    {
+        synthAudioSource.prepareToPlay (samplesPerBlockExpected, sampleRate);
+
+        juce::MessageManager::callAsync ([safeThis = juce::Component::SafePointer<MainContentComponent> (this)]
+        {
+            if (safeThis != nullptr)
+                safeThis->updateLatencyLabel();
+        });
+    }
+
+    void getNextAudioBlock (const juce::AudioSourceChannelInfo& bufferToFill) override
+    {
+        synthAudioSource.getNextAudioBlock (bufferToFill);
+    }
+
+    void releaseResources() override
+    {
+        synthAudioSource.releaseResources();
+    }
+
+    void sliderValueChanged(juce::Slider* slider) override
+    {
+        if (slider == &decaySlider) {
+            synthAudioSource.setDecay(decaySlider.getValue());
+        }
+        else if (slider == &cutoffSlider)
+        {
+            synthAudioSource.getFilterBank().setCutoff ((float) cutoffSlider.getValue());
+        }
+        else if (slider == &resonanceSlider)
+        {
+            synthAudioSource.getFilterBank().setResonance ((float) resonanceSlider.getValue());
+        }
+        else if (slider == &filterEnvSlider)
+        {
+            synthAudioSource.getFilterBank().setEnvelopeAmount ((float) filterEnvSlider.getValue());
+        }
+        else if (slider == &reverbWetSlider)
+        {
+            synthAudioSource.getReverb().setWetLevel ((float) reverbWetSlider.getValue());
+        }
+        else if (slider == &keyTrackingSlider)
+        {
+            auto& response = synthAudioSource.getNoteResponse();
+            auto settings = response.getSettings();
+            settings.keyTrackingDbPerOctave = (float) keyTrackingSlider.getValue();
+            response.setSettings (settings);
+        }
+        else if (slider == &velocityExponentSlider)
+        {
+            auto& response = synthAudioSource.getNoteResponse();
+            auto settings = response.getSettings();
+            settings.velocityExponent = (float) velocityExponentSlider.getValue();
+            response.setSettings (settings);
+        }
+        else if (slider == &partVoicesSlider)
+        {
+            auto voices = (int) partVoicesSlider.getValue();
+            editParts ([voices] (PartBank::Settings& part) { part.polyphony = voices; });
+        }
+        else if (slider == &partLevelSlider)
+        {
+            auto level = (float) partLevelSlider.getValue();
+            editParts ([level] (PartBank::Settings& part) { part.level = level; });
+        }
+        else if (slider == &partPanSlider)
+        {
+            auto pan = (float) partPanSlider.getValue();
+            editParts ([pan] (PartBank::Settings& part) { part.pan = pan; });
+        }
+    }
+
+private:
+    void addFilterSlider (juce::Slider& slider, juce::Label& label, const juce::String& name,
+                          double minimum, double maximum, double initial)
+    {
+        addAndMakeVisible (slider);
+        slider.setRange (minimum, maximum);
+        slider.setValue (initial, juce::dontSendNotification);
+        slider.addListener (this);
+
+        addAndMakeVisible (label);
+        label.setText (name, juce::dontSendNotification);
+        label.attachToComponent (&slider, true);
+    }
+
+    // The parts that the sound and part controls edit: one, or all of them.
+    juce::Range<int> getEditedParts() const
+    {
+        auto index = partList.getSelectedItemIndex();
+
+        return index <= 0 ? juce::Range<int> (0, PartBank::numParts)
+                          : juce::Range<int>::withStartAndLength (index - 1, 1);
+    }
+
+    template <typename Edit>
+    void editParts (Edit&& edit)
+    {
+        auto& parts = synthAudioSource.getParts();
+        auto edited = getEditedParts();
+
+        for (int part = edited.getStart(); part < edited.getEnd(); ++part)
+        {
+            auto settings = parts.get (part);
+            edit (settings);
+            parts.set (part, settings);
+        }
+    }
+
+    void showPart (const PartBank::Settings& part)
+    {
+        soundList.setSelectedItemIndex (part.sound, juce::dontSendNotification);
+        algorithmList.setEnabled (part.sound == EnginePreset::fmSound);
+        partVoicesSlider.setValue (part.polyphony, juce::dontSendNotification);
+        partLevelSlider.setValue (part.level, juce::dontSendNotification);
+        partPanSlider.setValue (part.pan, juce::dontSendNotification);
+    }
+
+    void updateLatencyLabel()
+    {
+        auto order = oversamplingList.getSelectedItemIndex();
+
+        latencyLabel.setText ("Added latency: " + juce::String (synthAudioSource.getLatencySamples (order)) + " samples",
+                              juce::dontSendNotification);
+    }
+
+    void chooseImpulseResponse()
+    {
+        impulseChooser = std::make_unique<juce::FileChooser> ("Choose an impulse response", juce::File(), "*.wav;*.aif;*.aiff;*.flac");
+
+        impulseChooser->launchAsync (juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                                     [this] (const juce::FileChooser& chooser)
+                                     {
+                                         auto file = chooser.getResult();
+
+                                         if (file.existsAsFile())
+                                             synthAudioSource.getReverb().loadImpulseResponse (file);
+                                     });
+    }
+
+    void chooseSampleFolder()
+    {
+        sampleChooser = std::make_unique<juce::FileChooser> ("Choose a folder of samples");
+
+        sampleChooser->launchAsync (juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectDirectories,
+                                    [this] (const juce::FileChooser& chooser)
+                                    {
+                                        auto library = SampleLibrary::loadFolder (chooser.getResult());
+
+                                        if (library->isEmpty())
+                                        {
+                                            showPart (synthAudioSource.getParts().get (getEditedParts().getStart()));
+                                            return;
+                                        }
+
+                                        synthAudioSource.setSampleLibrary (library);
+                                        editParts ([] (PartBank::Settings& part) { part.sound = EnginePreset::samplerSound; });
+                                        soundList.setSelectedItemIndex (EnginePreset::samplerSound, juce::dontSendNotification);
+                                        algorithmList.setEnabled (false);
+                                    });
+    }
+
+    void choosePresetFile (bool saving)
+    {
+        auto flags = saving ? juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting
+                            : juce::FileBrowserComponent::openMode;
+
+        presetChooser = std::make_unique<juce::FileChooser> (saving ? "Save preset" : "Load preset", juce::File(),
+                                                             juce::String ("*") + EnginePreset::fileExtension);
+
+        presetChooser->launchAsync (flags | juce::FileBrowserComponent::canSelectFiles,
+                                    [this, saving] (const juce::FileChooser& chooser)
+                                    {
+                                        auto file = chooser.getResult();
+
+                                        if (file == juce::File())
+                                            return;
+
+                                        if (saving)
+                                            savePreset (file.withFileExtension (EnginePreset::fileExtension));
+                                        else
+                                            loadPreset (file);
+                                    });
+    }
+
+    void savePreset (const juce::File& file)
+    {
+        auto preset = synthAudioSource.getPreset();
+        preset.midiInputIdentifiers = enabledMidiInputs;
+        preset.saveToFile (file);
+    }
+
+    // The engine gets the preset first; the widgets catch up afterwards
+    // without notifying, so nothing is set twice. A different oversampling
+    // order fades out and stops whatever is sounding, as choosing it from the
+    // list would.
+    void loadPreset (const juce::File& file)
+    {
+        EnginePreset preset;
+
+        if (! EnginePreset::loadFromFile (file, preset))
+            return;
+
+        synthAudioSource.recallPreset (preset);
+        synthAudioSource.setOversamplingOrder (preset.oversamplingOrder);
+
+        decaySlider.setValue (preset.decay, juce::dontSendNotification);
+        filterToggle.setToggleState (preset.filterEnabled, juce::dontSendNotification);
+        cutoffSlider.setValue (preset.cutoffHz, juce::dontSendNotification);
+        resonanceSlider.setValue (preset.resonance, juce::dontSendNotification);
+        filterEnvSlider.setValue (preset.filterEnvelopeOctaves, juce::dontSendNotification);
+        reverbToggle.setToggleState (preset.reverbEnabled, juce::dontSendNotification);
+        reverbWetSlider.setValue (preset.reverbWet, juce::dontSendNotification);
+        oversamplingList.setSelectedItemIndex (preset.oversamplingOrder, juce::dontSendNotification);
+        algorithmList.setSelectedItemIndex (preset.fmAlgorithm, juce::dontSendNotification);
+        velocityCurveList.setSelectedItemIndex (preset.noteResponse.velocityCurve, juce::dontSendNotification);
+        keyTrackingSlider.setValue (preset.noteResponse.keyTrackingDbPerOctave, juce::dontSendNotification);
+        velocityExponentSlider.setValue (preset.noteResponse.velocityExponent, juce::dontSendNotification);
+        velocityExponentSlider.setEnabled (preset.noteResponse.velocityCurve == (int) NoteCurves::Velocity::power);
+        showPart (preset.parts[getEditedParts().getStart()]);
+        updateLatencyLabel();
+
+        // Inputs the preset names but that aren't plugged in are skipped, and
+        // if none of them are, the current inputs stay on.
+        juce::StringArray wanted;
+
+        for (auto& input : midiInputDevices)
+            if (preset.midiInputIdentifiers.contains (input.identifier))
+                wanted.add (input.identifier);
+
+        if (wanted.isEmpty())
+            return;
+
+        for (auto& identifier : juce::StringArray (enabledMidiInputs))
+            if (! wanted.contains (identifier))
+                setMidiInputEnabled (identifier, false);
+
+        for (auto& identifier : wanted)
+            setMidiInputEnabled (identifier, true);
+    }
+
+    void updatePresetStats()
+    {
+        auto stats = synthAudioSource.getRecallStats();
+
+        if (stats.numApplied == 0)
+            return;
+
+        presetStatsLabel.setText ("Recalled in " + juce::String (stats.lastLatencyMs, 2) + " ms (max "
+                                    + juce::String (stats.maxLatencyMs, 2) + "), applied in "
+                                    + juce::String (stats.lastApplyMicros, 1) + " us",
+                                  juce::dontSendNotification);
+    }
+
+    void updateSamplerStats()
+    {
+        auto stats = synthAudioSource.getSamplerStats();
+
+        auto megabytes = [] (juce::uint64 bytes) { return juce::String ((double) bytes / (1024.0 * 1024.0), 1); };
+
+        samplerStatsLabel.setText ("Sampler: " + juce::String ((juce::int64) stats.underruns) + " underruns, "
+                                     + juce::String (stats.getHeadHitRate() * 100.0, 1) + "% head hits, "
+                                     + megabytes (stats.residentBytes) + "/" + megabytes (stats.budgetBytes) + " MB, "
+                                     + juce::String ((juce::int64) stats.evictions) + " evictions, prefetch "
+                                     + juce::String (stats.meanPrefetchMs, 1) + " ms (max "
+                                     + juce::String (stats.maxPrefetchMs, 1) + "), "
+                                     + juce::String ((juce::int64) stats.readersOpened) + " files opened",
+                                   juce::dontSendNotification);
+    }
+
+    // The first tick moves focus to the keyboard; after that the timer only
+    // keeps the MIDI inputs', sampler's and presets' counters up to date.
+    void timerCallback() override
+    {
+        if (! keyboardFocusGrabbed)
+        {
+            keyboardComponent.grabKeyboardFocus();
+            keyboardFocusGrabbed = true;
+        }
+
+        if (! realtimeReported)
+            reportRealtimeSetup();
+
+        if (! startupReported)
+            reportStartup();
+
+        updateMidiStats();
+        updateSamplerStats();
+        updatePresetStats();
+    }
+
+    // Any number of inputs can be on at once, each feeding its own port of
+    // the engine's merger. Picking one in the list turns it on or off, using
+    // the watcher's cached list rather than enumerating the devices again.
+    void toggleMidiInput (int index)
+    {
+        midiInputList.setSelectedId (0, juce::dontSendNotification);
+
+        if (! juce::isPositiveAndBelow (index, midiInputDevices.size()))
+            return;
+
+        auto identifier = midiInputDevices.getReference (index).identifier;
+        setMidiInputEnabled (identifier, ! enabledMidiInputs.contains (identifier));
+    }
+
+    void setMidiInputEnabled (const juce::String& identifier, bool shouldBeEnabled)
+    {
+        auto& merger = synthAudioSource.getMidiInputs();
+
+        if (shouldBeEnabled == enabledMidiInputs.contains (identifier))
+            return;
+
+        if (shouldBeEnabled)
+        {
+            auto* port = merger.openPort (identifier);
+
+            if (port == nullptr)
+                return;
+
+            if (! deviceManager.isMidiInputDeviceEnabled (identifier))
+                deviceManager.setMidiInputDeviceEnabled (identifier, true);
+
+            deviceManager.addMidiInputDeviceCallback (identifier, port);
+            enabledMidiInputs.add (identifier);
+        }
+        else
+        {
+            deviceManager.removeMidiInputDeviceCallback (identifier, merger.getPort (identifier));
+            merger.closePort (identifier);
+            enabledMidiInputs.removeString (identifier);
+        }
+
+        auto index = indexOfMidiInput (identifier);
+
+        if (index >= 0)
+            midiInputList.changeItemText (index + 1, getMidiInputItemText (index));
+
+        updateMidiInputSummary();
+    }
+
+    // The first list turns on whatever the device manager already had enabled,
+    // or else the first input.
+    void midiDevicesChanged()
+    {
+        auto devices = midiDeviceWatcher.getDevices();
+        auto isFirstList = ! midiDevicesListed;
+        midiDevicesListed = true;
+
+        // An input that was on when it was unplugged is reopened when it comes
+        // back; its callback was never removed.
+        for (auto& input : devices)
+        {
+            if (enabledMidiInputs.contains (input.identifier) && indexOfMidiInput (input.identifier) < 0)
+            {
+                deviceManager.setMidiInputDeviceEnabled (input.identifier, false);
+                deviceManager.setMidiInputDeviceEnabled (input.identifier, true);
+            }
+        }
+
+        updateMidiInputList (devices);
+
+        if (isFirstList)
+        {
+            for (auto& input : devices)
+                if (deviceManager.isMidiInputDeviceEnabled (input.identifier))
+                    setMidiInputEnabled (input.identifier, true);
+
+            if (enabledMidiInputs.isEmpty() && ! devices.isEmpty())
+                setMidiInputEnabled (devices[0].identifier, true);
+        }
+    }
+
+    // Devices that appeared at the end of the list are added to the box as
+    // they are; anything else rebuilds it.
+    void updateMidiInputList (const juce::Array<juce::MidiDeviceInfo>& devices)
+    {
+        auto onlyAppended = devices.size() >= midiInputDevices.size()
+                             && std::equal (midiInputDevices.begin(), midiInputDevices.end(), devices.begin());
+
+        if (! onlyAppended)
+        {
+            midiInputList.clear (juce::dontSendNotification);
+            midiInputDevices.clearQuick();
+        }
+
+        for (auto i = midiInputDevices.size(); i < devices.size(); ++i)
+        {
+            midiInputDevices.add (devices[i]);
+            midiInputList.addItem (getMidiInputItemText (i), i + 1);
+        }
+
+        updateMidiInputSummary();
+    }
+
+    int indexOfMidiInput (const juce::String& identifier) const
+    {
+        for (int i = 0; i < midiInputDevices.size(); ++i)
+            if (midiInputDevices.getReference (i).identifier == identifier)
+                return i;
+
+        return -1;
+    }
+
+    // Ticks mark the inputs that are on.
+    juce::String getMidiInputItemText (int index) const
+    {
+        auto& input = midiInputDevices.getReference (index);
+        auto isEnabled = enabledMidiInputs.contains (input.identifier);
+
+        return (isEnabled ? juce::String (juce::CharPointer_UTF8 ("\xe2\x9c\x93 ")) : juce::String ("    ")) + input.name;
+    }
+
+    // The box never has anything selected, so it shows the inputs that are on.
+    void updateMidiInputSummary()
+    {
+        juce::StringArray enabledNames;
+
+        for (auto& input : midiInputDevices)
+            if (enabledMidiInputs.contains (input.identifier))
+                enabledNames.add (input.name);
+
+        midiInputList.setTextWhenNothingSelected (enabledNames.isEmpty() ? "No MIDI Inputs Enabled"
+                                                                         : enabledNames.joinIntoString (", "));
+    }
+
+    // Logged once the audio thread has had its first callback, so that it's
+    // clear what the real-time setup did and didn't get.
+    void reportRealtimeSetup()
+    {
+        auto report = synthAudioSource.getRealtimeSetup().getReport();
+
+        if (report.isEmpty() || report[0].contains ("waiting"))
+            return;
+
+        for (auto& line : report)
+            juce::Logger::writeToLog (line);
+
+        realtimeReported = true;
+    }
+
+    // Logged once the first callbacks after the device started have all
+    // been timed.
+    void reportStartup()
+    {
+        auto stats = synthAudioSource.getStartupStats();
+
+        if (stats.numBlocksTimed < SynthAudioSource::numStartupBlocks)
+            return;
+
+        juce::Logger::writeToLog ("Startup: warm-up " + juce::String (stats.warmUpMs, 2) + " ms, first block "
+                                    + juce::String (stats.firstBlockMicros, 1) + " us, median "
+                                    + juce::String (stats.medianBlockMicros, 1) + " us, max "
+                                    + juce::String (stats.maxBlockMicros, 1) + " us over "
+                                    + juce::String (stats.numBlocksTimed) + " blocks");
+        startupReported = true;
+    }
+
+    void updateMidiStats()
+    {
+        juce::StringArray lines;
+
+        for (auto& stats : synthAudioSource.getMidiInputs().getStats())
+        {
+            auto index = indexOfMidiInput (stats.identifier);
+
+            lines.add ((index >= 0 ? midiInputDevices.getReference (index).name : stats.identifier) + " "
+                         + juce::String (stats.eventsPerSecond, 1) + " ev/s, "
+                         + juce::String (stats.meanLatencyMs, 2) + " ms (max "
+                         + juce::String (stats.maxLatencyMs, 2) + ")"
+                         + (stats.numDropped > 0 ? ", " + juce::String ((juce::int64) stats.numDropped) + " dropped" : juce::String()));
+        }
+
+        midiStatsLabel.setText ("MIDI (scan " + juce::String (midiDeviceWatcher.getLastScanMilliseconds(), 1) + " ms): "
+                                  + (lines.isEmpty() ? juce::String ("no inputs") : lines.joinIntoString ("; ")),
+                                juce::dontSendNotification);
+    }
+
+    //==========================================================================
+    juce::MidiKeyboardState keyboardState;
+    SynthAudioSource synthAudioSource;
+    KeyboardBridge keyboardBridge { keyboardState, synthAudioSource.getMidiInputs(), synthAudioSource.getNoteDisplay() };
+    juce::MidiKeyboardComponent keyboardComponent;
+
+    juce::ComboBox midiInputList;
+    juce::Label midiInputListLabel, midiStatsLabel;
+    juce::StringArray enabledMidiInputs;
+    juce::Array<juce::MidiDeviceInfo> midiInputDevices;   // as listed in midiInputList
+    MidiDeviceWatcher midiDeviceWatcher;
+    bool midiDevicesListed = false;
+
+    juce::Slider decaySlider;
+    juce::Label decayLabel;
+
+    juce::ToggleButton filterToggle;
+    juce::Slider cutoffSlider, resonanceSlider, filterEnvSlider;
+    juce::Label cutoffLabel, resonanceLabel, filterEnvLabel;
+
+    juce::ToggleButton reverbToggle, lowLatencyToggle, keyFeedbackToggle;
+    juce::TextButton loadImpulseButton;
+    juce::Slider reverbWetSlider;
+    juce::Label reverbWetLabel;
+    std::unique_ptr<juce::FileChooser> impulseChooser;
+
+    juce::ComboBox oversamplingList;
+    juce::Label oversamplingLabel, latencyLabel;
+
+    juce::ComboBox soundList, algorithmList;
+    juce::Label soundLabel;
+
+    juce::ComboBox partList;
+    juce::Slider partVoicesSlider, partLevelSlider, partPanSlider;
+    juce::Label partLabel, partVoicesLabel, partLevelLabel, partPanLabel;
+
+    juce::ComboBox velocityCurveList;
+    juce::Slider keyTrackingSlider, velocityExponentSlider;
+    juce::Label velocityCurveLabel, keyTrackingLabel, velocityExponentLabel;
+
+    juce::TextButton loadSamplesButton;
+    juce::Label samplerStatsLabel;
+    std::unique_ptr<juce::FileChooser> sampleChooser;
+
+    juce::TextButton savePresetButton, loadPresetButton;
+    juce::Label presetStatsLabel;
+    std::unique_ptr<juce::FileChooser> presetChooser;
+    bool keyboardFocusGrabbed = false, realtimeReported = false, startupReported = false;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MainContentComponent)
 };
@@ -0,0 +1,230 @@
+/*
+  ==============================================================================
+
+    Scope markers for looking inside a block, compiled in only when
+    SYNTH_TRACE is 1 (the SYNTH_ENABLE_TRACE CMake option). Otherwise
+    SYNTH_TRACE_SCOPE expands to nothing.
+
+    Each thread that records gets one of a fixed set of rings on its first
+    scope, or when it names itself, so recording never allocates or locks.
+    The ring is given back when the thread exits, and a thread with the same
+    name (or another unnamed one) picks it up again, so threads that get
+    restarted, like the reverb tail, don't use up the rings. A scope writes one complete event, its name and start and end
+    ticks, when it closes; nesting comes from the timestamps. A full ring
+    overwrites its oldest events.
+
+    writeChromeJson() is for the message thread. It copies out whatever the
+    rings hold, skipping any events that were overwritten while it read,
+    and writes the Chrome trace format, which Perfetto also opens.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#ifndef SYNTH_TRACE
+ #define SYNTH_TRACE 0
+#endif
+
+#if SYNTH_TRACE
+
+//==============================================================================
+class Trace
+{
+public:
+    static constexpr int maxThreads = 8;
+    static constexpr int eventsPerThread = 8192;
+
+    // Names the calling thread in the trace. Optional, but a thread that does
+    // it before its first scope goes back on the track of an earlier thread
+    // of the same name.
+    static void nameThread (const char* name) noexcept
+    {
+        if (auto* ring = getRing (name))
+            ring->name = name;
+    }
+
+    class Scope
+    {
+    public:
+        explicit Scope (const char* scopeName) noexcept
+            : name (scopeName), start (juce::Time::getHighResolutionTicks())
+        {
+        }
+
+        ~Scope()
+        {
+            if (auto* ring = getRing())
+                ring->add (name, start, juce::Time::getHighResolutionTicks());
+        }
+
+    private:
+        const char* name;
+        juce::int64 start;
+
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+
+    // How many scopes have been recorded so far, over every thread.
+    static juce::uint64 getNumRecorded() noexcept
+    {
+        juce::uint64 total = 0;
+        auto numClaimed = juce::jmin ((int) maxThreads, getNumClaimed().load());
+
+        for (int t = 0; t < numClaimed; ++t)
+            total += getRings()[(size_t) t].written.load (std::memory_order_acquire);
+
+        return total;
+    }
+
+    //==============================================================================
+    static bool writeChromeJson (const juce::File& file)
+    {
+        juce::MemoryOutputStream out;
+        auto ticksToMicros = 1.0e6 / (double) juce::Time::getHighResolutionTicksPerSecond();
+        auto first = true;
+
+        out << "{\"traceEvents\":[\n";
+
+        auto separator = [&]
+        {
+            if (! first)
+                out << ",\n";
+
+            first = false;
+        };
+
+        auto& rings = getRings();
+        auto numClaimed = juce::jmin ((int) maxThreads, getNumClaimed().load());
+
+        for (int t = 0; t < numClaimed; ++t)
+        {
+            auto& ring = rings[(size_t) t];
+            auto* name = ring.name.load();
+
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+                << ",\"args\":{\"name\":" << juce::JSON::toString (name != nullptr ? juce::String (name)
+                                                                                  : "Thread " + juce::String (t)) << "}}";
+
+            ring.forEach ([&] (const Event& e)
+            {
+                separator();
+                out << "{\"name\":" << juce::JSON::toString (juce::String (e.name))
+                    << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << t
+                    << ",\"ts\":" << juce::String ((double) e.start * ticksToMicros, 3)
+                    << ",\"dur\":" << juce::String ((double) (e.end - e.start) * ticksToMicros, 3) << "}";
+            });
+        }
+
+        out << "\n]}\n";
+        return file.replaceWithData (out.getData(), out.getDataSize());
+    }
+
+private:
+    struct Event
+    {
+        const char* name;
+        juce::int64 start, end;
+    };
+
+    struct Ring
+    {
+        void add (const char* name, juce::int64 start, juce::int64 end) noexcept
+        {
+            auto index = written.load (std::memory_order_relaxed);
+            events[(size_t) (index % eventsPerThread)] = { name, start, end };
+            written.store (index + 1, std::memory_order_release);
+        }
+
+        // Copies the events out, then drops any that the writer may have
+        // overwritten in the meantime.
+        template <typename Callback>
+        void forEach (Callback&& callback) const
+        {
+            auto end = written.load (std::memory_order_acquire);
+            auto begin = end > (juce::uint64) eventsPerThread ? end - (juce::uint64) eventsPerThread : 0;
+
+            std::vector<Event> copy;
+            copy.reserve ((size_t) (end - begin));
+
+            for (auto i = begin; i < end; ++i)
+                copy.push_back (events[(size_t) (i % eventsPerThread)]);
+
+            auto nowWritten = written.load (std::memory_order_acquire);
+            auto firstIntact = nowWritten > (juce::uint64) eventsPerThread ? nowWritten - (juce::uint64) eventsPerThread + 1 : 0;
+
+            for (auto i = juce::jmax (begin, firstIntact); i < end; ++i)
+                callback (copy[(size_t) (i - begin)]);
+        }
+
+        std::array<Event, (size_t) eventsPerThread> events;
+        std::atomic<juce::uint64> written { 0 };
+        std::atomic<const char*> name { nullptr };
+        std::atomic<bool> owned { true };   // until the thread that claimed it exits
+    };
+
+    // Gives the ring back when its thread exits.
+    struct Owner
+    {
+        ~Owner()
+        {
+            if (ring != nullptr)
+                ring->owned.store (false, std::memory_order_release);
+        }
+
+        Ring* ring = nullptr;
+        bool claimed = false;
+    };
+
+    static std::array<Ring, maxThreads>& getRings() noexcept
+    {
+        static std::array<Ring, maxThreads> rings;
+        return rings;
+    }
+
+    static std::atomic<int>& getNumClaimed() noexcept
+    {
+        static std::atomic<int> numClaimed { 0 };
+        return numClaimed;
+    }
+
+    static bool isSameName (const char* a, const char* b) noexcept
+    {
+        return a == b || (a != nullptr && b != nullptr && std::strcmp (a, b) == 0);
+    }
+
+    // Once every ring has been used, only a thread that can take over a
+    // released one of the same name records.
+    static Ring* getRing (const char* name = nullptr) noexcept
+    {
+        thread_local Owner owner;
+
+        if (owner.claimed)
+            return owner.ring;
+
+        owner.claimed = true;
+        auto& rings = getRings();
+        auto numClaimed = juce::jmin ((int) maxThreads, getNumClaimed().load());
+
+        for (int t = 0; t < numClaimed; ++t)
+        {
+            auto& ring = rings[(size_t) t];
+
+            if (isSameName (ring.name.load(), name) && ! ring.owned.exchange (true))
+                return owner.ring = &ring;
+        }
+
+        auto index = getNumClaimed()++;
+
+        return index < maxThreads ? (owner.ring = &rings[(size_t) index]) : nullptr;
+    }
+};
+
+ #define SYNTH_TRACE_SCOPE(name)   const Trace::Scope JUCE_JOIN_MACRO (traceScope, __LINE__) (name)
+ #define SYNTH_TRACE_THREAD(name)  Trace::nameThread (name)
+
+#else
+ #define SYNTH_TRACE_SCOPE(name)
+ #define SYNTH_TRACE_THREAD(name)
+#endif
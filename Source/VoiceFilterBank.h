@@ -0,0 +1,179 @@
+/*
+  ==============================================================================
+
+    A resonant lowpass per voice, with its cutoff swept by a decaying
+    envelope that restarts on every note-on.
+
+    Each voice renders into its own lane of a multichannel buffer. The bank
+    filters eight lanes at a time with the dispatched SVF kernel, so eight
+    voices cost one vector pass, and it only recomputes coefficients once per
+    block.
+
+    The engine has four sine voices, so half of its one group is padding.
+    The group stays eight wide anyway: that is one AVX register, the same
+    layout as the FM lanes, and a four-wide kernel would only be faster on
+    SSE2 and NEON, where eight lanes take two registers.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+//==============================================================================
+class VoiceFilterBank
+{
+public:
+    VoiceFilterBank() = default;
+
+    void setEnabled (bool shouldBeEnabled)     { enabled = shouldBeEnabled; }
+    bool isEnabled() const noexcept            { return enabled; }
+
+    void setCutoff (float newCutoffHz)         { cutoffHz = newCutoffHz; }
+    void setResonance (float newQ)             { resonance = newQ; }
+    void setEnvelopeAmount (float octaves)     { envelopeOctaves = octaves; }
+    void setEnvelopeDecay (float seconds)      { envelopeDecaySeconds = seconds; }
+
+    float getCutoff() const noexcept           { return cutoffHz; }
+    float getResonance() const noexcept        { return resonance; }
+    float getEnvelopeAmount() const noexcept   { return envelopeOctaves; }
+
+    void prepare (int numVoices, double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        numLanes = numVoices;
+
+        groups.clear();
+        groups.resize ((size_t) (numVoices + FilterLaneGroup::numLanes - 1) / FilterLaneGroup::numLanes);
+
+        envelopes.assign ((size_t) numVoices, 0.0f);
+        lastNoteCounters.assign ((size_t) numVoices, 0);
+    }
+
+    // Moves the filters to a new rate, silencing them, without allocating.
+    void setSampleRate (double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+
+        for (auto& g : groups)
+            g = {};
+
+        std::fill (envelopes.begin(), envelopes.end(), 0.0f);
+    }
+
+    //==============================================================================
+    // Filters the first numSamples of each lane in place. The voices must be in
+    // lane order and provide getNoteCounter() and isSounding().
+    template <typename VoiceArray>
+    void process (juce::AudioBuffer<float>& lanes, int numSamples, const VoiceArray& voices)
+    {
+        jassert (lanes.getNumChannels() >= numLanes && voices.size() >= numLanes);
+
+        juce::ScopedNoDenormals noDenormals;
+        auto& kernels = RenderKernels::getActive();
+        constexpr int groupSize = FilterLaneGroup::numLanes;
+
+        updateCoefficients (numSamples, voices);
+
+        for (int g = 0; g < (int) groups.size(); ++g)
+        {
+            auto firstLane = g * groupSize;
+            auto numInGroup = juce::jmin (groupSize, numLanes - firstLane);
+            auto anySounding = false;
+
+            for (int l = 0; l < numInGroup; ++l)
+                anySounding = anySounding || voices[firstLane + l]->isSounding();
+
+            if (! anySounding)
+            {
+                groups[(size_t) g] = {};
+                continue;
+            }
+
+            for (int start = 0; start < numSamples; start += chunkSize)
+            {
+                auto n = juce::jmin (chunkSize, numSamples - start);
+
+                for (int l = 0; l < groupSize; ++l)
+                {
+                    if (l < numInGroup)
+                    {
+                        auto* src = lanes.getReadPointer (firstLane + l, start);
+
+                        for (int i = 0; i < n; ++i)
+                            interleaved[i * groupSize + l] = src[i];
+                    }
+                    else
+                    {
+                        for (int i = 0; i < n; ++i)
+                            interleaved[i * groupSize + l] = 0.0f;
+                    }
+                }
+
+                kernels.filter (interleaved, n, groups[(size_t) g]);
+
+                for (int l = 0; l < numInGroup; ++l)
+                {
+                    auto* dst = lanes.getWritePointer (firstLane + l, start);
+
+                    for (int i = 0; i < n; ++i)
+                        dst[i] = interleaved[i * groupSize + l];
+                }
+            }
+        }
+    }
+
+private:
+    //==============================================================================
+    template <typename VoiceArray>
+    void updateCoefficients (int numSamples, const VoiceArray& voices)
+    {
+        auto baseCutoff = cutoffHz.load();
+        auto envAmount = envelopeOctaves.load();
+        auto k = 1.0f / juce::jmax (0.1f, resonance.load());
+        auto maxCutoff = (float) sampleRate * 0.45f;
+        auto envDecay = (float) std::exp (-numSamples / (juce::jmax (0.001f, envelopeDecaySeconds.load()) * sampleRate));
+
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            auto& group = groups[(size_t) (lane / FilterLaneGroup::numLanes)];
+            auto l = lane % FilterLaneGroup::numLanes;
+            auto counter = voices[lane]->getNoteCounter();
+
+            if (counter != lastNoteCounters[(size_t) lane])
+            {
+                lastNoteCounters[(size_t) lane] = counter;
+                envelopes[(size_t) lane] = 1.0f;
+                group.ic1eq[l] = 0.0f;
+                group.ic2eq[l] = 0.0f;
+            }
+
+            auto& env = envelopes[(size_t) lane];
+            auto cutoff = juce::jlimit (20.0f, maxCutoff, baseCutoff * std::exp2 (envAmount * env));
+            auto g = (float) std::tan (juce::MathConstants<double>::pi * cutoff / sampleRate);
+
+            group.a1[l] = 1.0f / (1.0f + g * (g + k));
+            group.a2[l] = g * group.a1[l];
+            group.a3[l] = g * group.a2[l];
+
+            env *= envDecay;
+        }
+    }
+
+    //==============================================================================
+    static constexpr int chunkSize = 64;
+
+    std::atomic<bool> enabled { false };
+    std::atomic<float> cutoffHz { 2000.0f }, resonance { 0.707f },
+                       envelopeOctaves { 2.0f }, envelopeDecaySeconds { 0.3f };
+
+    double sampleRate = 44100.0;
+    int numLanes = 0;
+
+    std::vector<FilterLaneGroup> groups;
+    std::vector<float> envelopes;
+    std::vector<juce::uint32> lastNoteCounters;
+
+    float interleaved[chunkSize * FilterLaneGroup::numLanes];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VoiceFilterBank)
+};